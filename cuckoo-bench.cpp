@@ -0,0 +1,65 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include "cuckoo-hash.hpp"
+
+using namespace std;
+
+// Times sequential contains/lookup against interleaved lookupAsync on a map
+// larger than cache. Usage: cuckoo-bench [numKeys] [inFlight]
+int main(int argc, char** argv)
+{
+    size_t numKeys = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1 << 21;
+    size_t inFlight = argc > 2 ? strtoul(argv[2], nullptr, 10) : 16;
+    size_t numQueries = 1 << 22;
+
+    CuckooHashMap<long, long> map;
+    for (size_t i = 1; i <= numKeys; ++i){
+        map.insert(long(i), long(i));
+    }
+    mt19937_64 rng(42);
+    uniform_int_distribution<long> dist(1, 2 * numKeys); // About half are misses
+    vector<long> queries(numQueries);
+    for (long &q : queries){
+        q = dist(rng);
+    }
+
+    auto start = chrono::steady_clock::now();
+    long seqSum = 0;
+    for (long q : queries){
+        if (map.contains(q)){
+            seqSum += map.lookup(q);
+        }
+    }
+    double seqTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    long asyncSum = 0;
+    CuckooScheduler scheduler;
+    vector<CuckooTask<long*>> tasks;
+    tasks.reserve(inFlight);
+    for (size_t i = 0; i < numQueries; i += inFlight){
+        tasks.clear();
+        for (size_t j = i; j < min(i + inFlight, numQueries); ++j){
+            tasks.push_back(map.lookupAsync(queries[j], scheduler));
+            tasks.back().start(scheduler, [&asyncSum](long* value){
+                if (value){
+                    asyncSum += *value;
+                }
+            });
+        }
+        scheduler.run();
+    }
+    double asyncTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (seqSum != asyncSum){
+        cerr << "Mismatch: " << seqSum << " != " << asyncSum << endl;
+        return 1;
+    }
+    cout << "Keys: " << numKeys << " Queries: " << numQueries << " In flight: " << inFlight << endl;
+    cout << "Sequential contains: " << numQueries / seqTime / 1e6 << " M lookups/s" << endl;
+    cout << "Interleaved lookupAsync: " << numQueries / asyncTime / 1e6 << " M lookups/s" << endl;
+    cout << "Speedup: " << seqTime / asyncTime << "x" << endl;
+}
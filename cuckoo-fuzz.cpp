@@ -0,0 +1,246 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "cuckoo-hash.hpp"
+
+using namespace std;
+
+/*
+ * Differential fuzz and soak test. Random insert/erase/lookup/clear/iterate
+ * sequences run against CuckooHashMap, CuckooHashSet and CuckooFilter, and
+ * every result is checked against std::unordered_map and std::unordered_set.
+ * Each operation is timed so rehash cascades show up as latency outliers.
+ *
+ * Soak mode:   cuckoo-fuzz [iterations] [seed] [keyRange]
+ * libFuzzer:   build with -fsanitize=fuzzer -DCUCKOO_FUZZ_LIBFUZZER (make fuzz)
+ */
+
+enum Op { Insert, Erase, Lookup, Assign, Clear, Iterate, NumOps };
+const char* opNames[NumOps] = {"insert", "erase", "lookup", "assign", "clear", "iterate"};
+
+// Latency histogram with power of 2 nanosecond buckets
+struct Latency {
+    size_t buckets[64] = {};
+    size_t count = 0;
+    uint64_t maxNs = 0;
+
+    void record(uint64_t ns){
+        buckets[ns ? 63 - __builtin_clzll(ns) : 0]++;
+        ++count;
+        maxNs = max(maxNs, ns);
+    }
+
+    // Upper bound of the bucket holding the given percentile
+    uint64_t percentile(double p) const {
+        size_t target = size_t(p * count);
+        size_t seen = 0;
+        for (size_t b = 0; b < 64; ++b){
+            seen += buckets[b];
+            if (seen > target){
+                return uint64_t(2) << b;
+            }
+        }
+        return maxNs;
+    }
+};
+
+class Harness {
+  private:
+    CuckooHashMap<int, int> map_;
+    unordered_map<int, int> mapModel_;
+    CuckooHashSet<string> set_;
+    unordered_set<string> setModel_;
+    CuckooFilter<string> filter_;
+    Latency latency_[NumOps];
+    size_t step_ = 0;
+
+    [[noreturn]] void fail(const string& what, Op op, int key){
+        cerr << "Mismatch at step " << step_ << " (" << opNames[op] << " " << key << "): " << what << endl;
+        abort();
+    }
+
+    void check(bool ok, const string& what, Op op, int key){
+        if (!ok){
+            fail(what, op, key);
+        }
+    }
+
+    void checkAll(Op op, int key){
+        check(map_.size() == mapModel_.size(), "map size", op, key);
+        check(set_.size() == setModel_.size(), "set size", op, key);
+        check(map_.empty() == mapModel_.empty(), "map empty", op, key);
+        size_t seen = 0;
+        for (auto [k, v] : map_){
+            auto it = mapModel_.find(k);
+            check(it != mapModel_.end() and it->second == v, "map iterator value", op, key);
+            ++seen;
+        }
+        check(seen == mapModel_.size(), "map iterator count", op, key);
+        seen = 0;
+        for (string s : set_){
+            check(setModel_.count(s) == 1, "set iterator value", op, key);
+            ++seen;
+        }
+        check(seen == setModel_.size(), "set iterator count", op, key);
+        for (const string& s : setModel_){
+            check(filter_.contains(s), "filter false negative", op, key);
+        }
+    }
+
+  public:
+    // Fixed hash seeds, so a failure replays from the soak seed or fuzz input
+    Harness(uint64_t seed){
+        map_.seed(seed);
+        set_.seed(seed ^ 0x5851F42D4C957F2DULL);
+    }
+
+    void run(Op op, int key, int value){
+        ++step_;
+        string skey = "key" + to_string(key);
+        auto start = chrono::steady_clock::now();
+        switch (op){
+            case Insert: {
+                map_.insert(key, value);
+                mapModel_.emplace(key, value); // insert doesn't overwrite
+                if (!set_.contains(skey)){
+                    filter_.insert(skey);
+                }
+                set_.insert(skey);
+                setModel_.insert(skey);
+                break;
+            }
+            case Erase: {
+                map_.erase(key);
+                mapModel_.erase(key);
+                if (set_.contains(skey)){
+                    filter_.erase(skey);
+                }
+                set_.erase(skey);
+                setModel_.erase(skey);
+                break;
+            }
+            case Lookup: {
+                auto it = mapModel_.find(key);
+                check(map_.contains(key) == (it != mapModel_.end()), "map contains", op, key);
+                if (it != mapModel_.end()){
+                    check(map_.lookup(key) == it->second, "map lookup", op, key);
+                } else {
+                    bool threw = false;
+                    try {
+                        map_.lookup(key);
+                    } catch (const out_of_range&) {
+                        threw = true;
+                    }
+                    check(threw, "lookup of a missing key didn't throw", op, key);
+                }
+                check(set_.contains(skey) == (setModel_.count(skey) == 1), "set contains", op, key);
+                break;
+            }
+            case Assign: {
+                auto it = mapModel_.find(key);
+                if (it != mapModel_.end()){
+                    map_[key] = value;
+                    it->second = value;
+                }
+                break;
+            }
+            case Clear: {
+                map_.clear();
+                mapModel_.clear();
+                set_.clear();
+                setModel_.clear();
+                filter_.clear();
+                break;
+            }
+            case Iterate: {
+                checkAll(op, key);
+                break;
+            }
+            default:
+                break;
+        }
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        latency_[op].record(ns);
+        if (op != Iterate and step_ % 1024 == 0){
+            checkAll(op, key);
+        }
+    }
+
+    void finish(){
+        checkAll(Iterate, 0);
+    }
+
+    // Flags operations far slower than their median, usually rehash cascades
+    void report(ostream& os) const {
+        for (size_t op = 0; op < NumOps; ++op){
+            const Latency& l = latency_[op];
+            if (l.count == 0){
+                continue;
+            }
+            uint64_t p50 = l.percentile(0.5);
+            os << opNames[op] << ": " << l.count << " ops, p50 <= " << p50 << "ns, p99 <= "
+               << l.percentile(0.99) << "ns, p99.99 <= " << l.percentile(0.9999) << "ns, max "
+               << l.maxNs << "ns";
+            if (l.maxNs > 1000 * p50){
+                os << "  <-- outlier";
+            }
+            os << endl;
+        }
+    }
+};
+
+// Clear and iterate are rare so the tables get a chance to grow
+Op pickOp(uint32_t r){
+    r %= 1000;
+    if (r < 400) return Insert;
+    if (r < 700) return Lookup;
+    if (r < 900) return Erase;
+    if (r < 995) return Assign;
+    if (r < 998) return Iterate;
+    return Clear;
+}
+
+#ifdef CUCKOO_FUZZ_LIBFUZZER
+
+// Each 4 byte record is an op selector, a key and a value
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size){
+    // FNV-1a of the input picks the hash seeds
+    uint64_t seed = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; ++i){
+        seed = (seed ^ data[i]) * 0x100000001B3ULL;
+    }
+    Harness harness(seed);
+    for (size_t i = 0; i + 4 <= size; i += 4){
+        uint32_t selector = data[i] | (data[i + 1] << 8);
+        harness.run(pickOp(selector), data[i + 2], data[i + 3]);
+    }
+    harness.finish();
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv)
+{
+    size_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : random_device()();
+    int keyRange = argc > 3 ? atoi(argv[3]) : 10000;
+
+    cout << "Seed: " << seed << " Iterations: " << iterations << " Key range: " << keyRange << endl;
+    mt19937_64 rng(seed);
+    uniform_int_distribution<int> keys(0, keyRange - 1);
+    Harness harness(seed);
+    for (size_t i = 0; i < iterations; ++i){
+        harness.run(pickOp(uint32_t(rng())), keys(rng), int(rng()));
+    }
+    harness.finish();
+    harness.report(cout);
+    cout << "OK" << endl;
+}
+
+#endif
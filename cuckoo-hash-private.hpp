@@ -1,52 +1,319 @@
 #include "cuckoo-hash.hpp"
 #include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
+/***********
+ * Hashing *
+ ***********/
+
+// splitmix64 finalizer: every output bit depends on every input bit
+inline uint64_t cuckooMix(uint64_t h){
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+/*****************
+ * Serialization *
+ *****************/
+
+template <typename T>
+void cuckooWrite(ostream &os, const T &field){
+    if constexpr (std::is_same_v<T, string>){
+        uint64_t length = field.size();
+        os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        os.write(field.data(), length);
+    } else {
+        static_assert(std::is_trivially_copyable_v<T>, "cuckooWrite needs a trivially copyable type or std::string");
+        os.write(reinterpret_cast<const char*>(&field), sizeof(T));
+    }
+}
+
+template <typename T>
+bool cuckooRead(istream &is, T &field){
+    if constexpr (std::is_same_v<T, string>){
+        uint64_t length = 0;
+        if (!is.read(reinterpret_cast<char*>(&length), sizeof(length))){
+            return false;
+        }
+        field.resize(length);
+        is.read(field.data(), length);
+    } else {
+        static_assert(std::is_trivially_copyable_v<T>, "cuckooRead needs a trivially copyable type or std::string");
+        is.read(reinterpret_cast<char*>(&field), sizeof(T));
+    }
+    return bool(is);
+}
+
+// Heap bytes owned by a field, std::string outside the small string buffer
+template <typename T>
+size_t cuckooHeapBytes(const T &field){
+    if constexpr (std::is_same_v<T, string>){
+        const char *begin = reinterpret_cast<const char*>(&field);
+        std::less<const char*> less;
+        bool isInline = !less(field.data(), begin) and less(field.data(), begin + sizeof(field));
+        return isInline ? 0 : field.capacity() + 1;
+    } else {
+        return 0;
+    }
+}
+
+// FNV-1a, catches log records torn by a crash mid write
+inline uint32_t cuckooChecksum(const string &bytes){
+    uint32_t h = 2166136261u;
+    for (char c : bytes){
+        h = (h ^ (unsigned char)c) * 16777619u;
+    }
+    return h;
+}
+
+/*****************
+ * Async Lookups *
+ *****************/
+
+inline CuckooScheduler::Yield CuckooScheduler::yield(){
+    return Yield{*this};
+}
+
+inline void CuckooScheduler::schedule(std::coroutine_handle<> handle){
+    ready_.push_back(handle);
+}
+
+inline void CuckooScheduler::run(){
+    while (!ready_.empty()){
+        std::coroutine_handle<> handle = ready_.front();
+        ready_.pop_front();
+        handle.resume();
+    }
+}
+
+inline bool CuckooScheduler::empty() const {
+    return ready_.empty();
+}
+
+template <typename T>
+CuckooTask<T>::CuckooTask(std::coroutine_handle<promise_type> handle):handle_{handle}{
+    // Nothing here
+}
+
+template <typename T>
+CuckooTask<T>::CuckooTask(CuckooTask &&other) noexcept:handle_{other.handle_}{
+    other.handle_ = nullptr;
+}
+
+template <typename T>
+CuckooTask<T>::~CuckooTask(){
+    if (handle_){
+        handle_.destroy();
+    }
+}
+
+template <typename T>
+CuckooTask<T> CuckooTask<T>::promise_type::get_return_object(){
+    return CuckooTask(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+template <typename T>
+std::coroutine_handle<> CuckooTask<T>::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+    promise_type &promise = handle.promise();
+    if (promise.onDone_){
+        promise.onDone_(promise.value_);
+    }
+    if (promise.continuation_){
+        return promise.continuation_;
+    }
+    return std::noop_coroutine();
+}
+
+template <typename T>
+void CuckooTask<T>::start(CuckooScheduler &scheduler, std::function<void(T)> onDone){
+    handle_.promise().onDone_ = std::move(onDone);
+    scheduler.schedule(handle_);
+}
+
+template <typename T>
+bool CuckooTask<T>::done() const {
+    return handle_.done();
+}
+
+template <typename T>
+T CuckooTask<T>::result() const {
+    return handle_.promise().value_;
+}
+
+template <typename T>
+std::coroutine_handle<> CuckooTask<T>::await_suspend(std::coroutine_handle<> awaiter){
+    handle_.promise().continuation_ = awaiter;
+    return handle_;
+}
+
 /*******************
  * Cuckoo Hash Map *
  *******************/
 
 template <typename key_t, typename value_t>
 CuckooHashMap<key_t, value_t>::CuckooHashMap():
-    table1_{new Item[2]}, 
-    table2_{new Item[2]}, 
+    numaNode_{-1},
+    table1_{allocateTable(2)}, 
+    table2_{allocateTable(2)}, 
     epsilon_{0.4}, // ??
     size_{0},
     maxLoop_{1}, // ??
     numBuckets_{2},
-    downsizeThresh_{0.2}
+    seed1_{randomSeed()},
+    seed2_{randomSeed()},
+    reseeds_{0},
+    fixedSeeds_{false},
+    seedState_{0},
+    downsizeThresh_{0.2},
+    accessAware_{false},
+    peakResizeBytes_{0}
     {
         // Nothing here
     }
 
 template<typename key_t, typename value_t>
 CuckooHashMap<key_t, value_t>::CuckooHashMap(double epsilon, float downsizeThresh):
-    table1_{new Item[2]}, 
-    table2_{new Item[2]}, 
+    CuckooHashMap(epsilon, downsizeThresh, -1)
+    {
+        // Nothing here
+    }
+
+template<typename key_t, typename value_t>
+CuckooHashMap<key_t, value_t>::CuckooHashMap(double epsilon, float downsizeThresh, int numaNode):
+    numaNode_{numaNode},
+    table1_{allocateTable(2)}, 
+    table2_{allocateTable(2)}, 
     epsilon_{epsilon}, // ??
     size_{0},
     maxLoop_{2}, // ??
     numBuckets_{2},
-    downsizeThresh_{downsizeThresh}
+    seed1_{randomSeed()},
+    seed2_{randomSeed()},
+    reseeds_{0},
+    fixedSeeds_{false},
+    seedState_{0},
+    downsizeThresh_{downsizeThresh},
+    accessAware_{false},
+    peakResizeBytes_{0}
     {
         // Nothing here
     }
 
+template<typename key_t, typename value_t>
+CuckooHashMap<key_t, value_t>::CuckooHashMap(const CuckooHashMap &other):
+    numaNode_{other.numaNode_},
+    table1_{allocateTable(other.numBuckets_)},
+    table2_{allocateTable(other.numBuckets_)},
+    epsilon_{other.epsilon_},
+    size_{other.size_},
+    maxLoop_{other.maxLoop_},
+    numBuckets_{other.numBuckets_},
+    seed1_{other.seed1_},
+    seed2_{other.seed2_},
+    reseeds_{other.reseeds_},
+    fixedSeeds_{other.fixedSeeds_},
+    seedState_{other.seedState_},
+    downsizeThresh_{other.downsizeThresh_},
+    accessAware_{other.accessAware_},
+    peakResizeBytes_{0}
+    {
+        // Same seeds and size, so every slot copies straight across
+        std::copy(other.table1_, other.table1_ + numBuckets_, table1_);
+        std::copy(other.table2_, other.table2_ + numBuckets_, table2_);
+    }
+
+template<typename key_t, typename value_t>
+CuckooHashMap<key_t, value_t>& CuckooHashMap<key_t, value_t>::operator=(const CuckooHashMap &other){
+    // Copy first so a throwing copy leaves this map untouched, then swap,
+    // and the copy's destructor frees the old tables
+    CuckooHashMap copy(other);
+    std::swap(numaNode_, copy.numaNode_);
+    std::swap(table1_, copy.table1_);
+    std::swap(table2_, copy.table2_);
+    std::swap(epsilon_, copy.epsilon_);
+    std::swap(size_, copy.size_);
+    std::swap(maxLoop_, copy.maxLoop_);
+    std::swap(numBuckets_, copy.numBuckets_);
+    std::swap(seed1_, copy.seed1_);
+    std::swap(seed2_, copy.seed2_);
+    std::swap(reseeds_, copy.reseeds_);
+    std::swap(fixedSeeds_, copy.fixedSeeds_);
+    std::swap(seedState_, copy.seedState_);
+    std::swap(downsizeThresh_, copy.downsizeThresh_);
+    std::swap(accessAware_, copy.accessAware_);
+    std::swap(peakResizeBytes_, copy.peakResizeBytes_);
+    return *this;
+}
+
 template<typename key_t, typename value_t>
 CuckooHashMap<key_t, value_t>::~CuckooHashMap(){
-    delete[] table1_;
-    delete[] table2_;
+    freeTable(table1_, numBuckets_);
+    freeTable(table2_, numBuckets_);
+}
+
+template<typename key_t, typename value_t>
+typename CuckooHashMap<key_t, value_t>::Item* CuckooHashMap<key_t, value_t>::allocateTable(size_t numBuckets) const {
+#ifdef CUCKOO_HASH_HAS_LIBNUMA
+    if (numaNode_ >= 0 and numa_available() >= 0){
+        Item* table = static_cast<Item*>(numa_alloc_onnode(numBuckets * sizeof(Item), numaNode_));
+        if (table == nullptr){
+            throw std::bad_alloc();
+        }
+        for (Item *item = table; item < table + numBuckets; ++item){
+            new (item) Item();
+        }
+        return table;
+    }
+#endif
+    return new Item[numBuckets];
+}
+
+template<typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::freeTable(Item* table, size_t numBuckets) const {
+#ifdef CUCKOO_HASH_HAS_LIBNUMA
+    if (numaNode_ >= 0 and numa_available() >= 0){
+        for (Item *item = table; item < table + numBuckets; ++item){
+            item->~Item();
+        }
+        numa_free(table, numBuckets * sizeof(Item));
+        return;
+    }
+#endif
+    delete[] table;
+}
+
+template<typename key_t, typename value_t>
+size_t CuckooHashMap<key_t, value_t>::randomSeed() {
+    static std::random_device rd;
+    return size_t((uint64_t(rd()) << 32) | rd());
+}
+
+template<typename key_t, typename value_t>
+size_t CuckooHashMap<key_t, value_t>::nextSeed() {
+    if (fixedSeeds_){
+        // splitmix64 stream, so a run can be replayed from its seed
+        seedState_ += 0x9E3779B97F4A7C15ULL;
+        return size_t(cuckooMix(seedState_));
+    }
+    return randomSeed();
 }
 
 template<typename key_t, typename value_t>
 size_t CuckooHashMap<key_t, value_t>::getHash1(const key_t& key) const {
-    return hash1_(key);
+    // Mix the seed in so bucket indices can't be predicted from std::hash
+    return size_t(cuckooMix(uint64_t(hash1_(key)) ^ seed1_));
 }
 
 template<typename key_t, typename value_t>
 size_t CuckooHashMap<key_t, value_t>::getHash2(size_t hash1) const {
     string key_str;
+    hash1 ^= seed2_;
     for (size_t byte = 0; byte < 8; ++byte)
     {
         unsigned char c = hash1 & 255;
@@ -73,54 +340,118 @@ size_t CuckooHashMap<key_t, value_t>::size() const{
 
 template <typename key_t, typename value_t>
 void CuckooHashMap<key_t, value_t>::clear(){
-    delete[] table1_;
-    delete[] table2_;
-    table1_ = new Item[2];
-    table2_ = new Item[2];
+    freeTable(table1_, numBuckets_);
+    freeTable(table2_, numBuckets_);
+    table1_ = allocateTable(2);
+    table2_ = allocateTable(2);
     numBuckets_ = 2;
     maxLoop_ = 1;
     size_ = 0;
+    reseeds_ = 0;
 }
 
 template <typename key_t, typename value_t>
 void CuckooHashMap<key_t, value_t>::rehash(size_t numBuckets){
+    rehash(numBuckets, false);
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::rehash(size_t numBuckets, bool reseed){
+    if (reseed){
+        seed1_ = nextSeed();
+        seed2_ = nextSeed();
+    }
+    // Move the live items out, so scratch is only size_ Items and key heap isn't duplicated
     vector<Item> allItems;
+    allItems.reserve(size_);
     for (Item *item = table1_; item < table1_ + numBuckets_; ++item)
     {
         if (item->valid_){
-            allItems.push_back(*item);
+            allItems.push_back(std::move(*item));
         }
     }
     for (Item *item = table2_; item < table2_ + numBuckets_; ++item){
         if(item->valid_){
-            allItems.push_back(*item);
+            allItems.push_back(std::move(*item));
         }
     }
-    delete[] table1_;
-    delete[] table2_;
+    size_t tableBytes = 2 * std::max(numBuckets, numBuckets_) * sizeof(Item);
+    peakResizeBytes_ = std::max(peakResizeBytes_, tableBytes + allItems.capacity() * sizeof(Item));
+    freeTable(table1_, numBuckets_);
+    freeTable(table2_, numBuckets_);
 
     // Rehash into new table;
+    if (numBuckets != numBuckets_){
+        reseeds_ = 0;
+    }
     numBuckets_ = numBuckets;
-    table1_ = new Item[numBuckets_];
-    table2_ = new Item[numBuckets_];
+    table1_ = allocateTable(numBuckets_);
+    table2_ = allocateTable(numBuckets_);
     for (Item &item : allItems)
     {
-        insert(item.key_, item.value_, false);
+        insert(std::move(item), false); // Keeps the hit counts
     }
     return;
 }
 
+template <typename key_t, typename value_t>
+CuckooMemoryUsage CuckooHashMap<key_t, value_t>::memoryUsage() const {
+    CuckooMemoryUsage usage{};
+    usage.slotBytes = 2 * numBuckets_ * sizeof(Item);
+    size_t unpadded = sizeof(key_t) + sizeof(value_t) + sizeof(bool) + sizeof(uint8_t);
+    usage.paddingBytes = 2 * numBuckets_ * (sizeof(Item) - std::min(unpadded, sizeof(Item)));
+    usage.metadataBytes = sizeof(*this);
+    for (Item *table : {table1_, table2_}){
+        for (Item *item = table; item < table + numBuckets_; ++item){
+            if (item->valid_){
+                usage.heapBytes += cuckooHeapBytes(item->key_) + cuckooHeapBytes(item->value_);
+            }
+        }
+    }
+    usage.peakResizeBytes = peakResizeBytes_;
+    return usage;
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::compact(double targetLoad){
+    // Rehash scratch holds only the live items, moved out of the old tables
+    if (!(targetLoad > 0)){
+        throw std::invalid_argument("CuckooHashMap: compact needs a positive target load");
+    }
+    // Above this, failed insertion cycles double the table again
+    targetLoad = std::min(targetLoad, 1 / (2 * (1 + epsilon_)));
+    size_t numBuckets = size_t(ceil(size_ / (2 * targetLoad)));
+    rehash(std::max(numBuckets, size_t(2)));
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::reseed(){
+    rehash(numBuckets_, true);
+}
+
+template<typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::seed(uint64_t seed){
+    fixedSeeds_ = true;
+    seedState_ = seed;
+    rehash(numBuckets_, true);
+}
+
 template <typename key_t, typename value_t>
 bool CuckooHashMap<key_t, value_t>::contains(const key_t& key) const {
     size_t hash1 = getHash1(key);
     Item &item1 = table1_[hash1 % numBuckets_];
     if (item1.valid_ and item1.key_ == key){
-        return item1.value_;
+        recordHit(item1);
+        return true;
     } else {
         // Only compute hash2 if not found in hash1. Hashing is expensive
         size_t hash2 = getHash2(hash1);
         Item &item2 = table2_[hash2 % numBuckets_];
-        return item2.valid_ and item2.key_ == key;
+        if (item2.valid_ and item2.key_ == key){
+            recordHit(item2);
+            return true;
+        }
+        return false;
     }
     return false;
 }
@@ -131,39 +462,72 @@ void CuckooHashMap<key_t, value_t>::insert(const key_t& key, const value_t& valu
     value_t valueCopy = value;
 
     Item newItem = Item(keyCopy, valueCopy); // Copy constructor is needed. 
-    if (contains(key)) {
-        return;
-    } else {
-        for (size_t loops = 0; loops < maxLoop_; ++loops){
-            size_t h1 = getHash1(newItem.key_);
-            // Empty spot, insert and finish
-            if (!table1_[h1%numBuckets_].valid_){
-                table1_[h1%numBuckets_] = newItem;
-                if(updateValues){
-                    ++size_;
-                    maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
-                }
-                return;
+    if (!contains(key)) {
+        insert(newItem, updateValues);
+    }
+    return;
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::insert(Item newItem, bool updateValues){
+    if (accessAware_){
+        // Leave a hotter item in table 1 if the new one fits in table 2
+        size_t h1 = getHash1(newItem.key_);
+        Item &resident = table1_[h1 % numBuckets_];
+        Item &item2 = table2_[getHash2(h1) % numBuckets_];
+        if (resident.valid_ and resident.hits_ > newItem.hits_ and !item2.valid_){
+            item2 = std::move(newItem);
+            if(updateValues){
+                ++size_;
+                maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
             }
-            else {
-                std::swap(newItem, table1_[h1 % numBuckets_]);
+            return;
+        }
+    }
+    for (size_t loops = 0; loops < maxLoop_; ++loops){
+        size_t h1 = getHash1(newItem.key_);
+        // Empty spot, insert and finish
+        if (!table1_[h1%numBuckets_].valid_){
+            table1_[h1%numBuckets_] = std::move(newItem);
+            if(updateValues){
+                ++size_;
+                maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
             }
-            size_t h2 = getHash2(getHash1(newItem.key_)); // This is slow!
-            if (!table2_[h2 % numBuckets_].valid_){
-                table2_[h2 % numBuckets_] = newItem;
-                if(updateValues){
-                    ++size_;
-                    maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
-                }
-                return;
-            } else {
-                std::swap(newItem, table2_[h2 % numBuckets_]);
+            return;
+        }
+        else {
+            std::swap(newItem, table1_[h1 % numBuckets_]);
+        }
+        size_t h2 = getHash2(getHash1(newItem.key_)); // This is slow!
+        if (!table2_[h2 % numBuckets_].valid_){
+            table2_[h2 % numBuckets_] = std::move(newItem);
+            if(updateValues){
+                ++size_;
+                maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
             }
+            return;
+        } else {
+            std::swap(newItem, table2_[h2 % numBuckets_]);
+        }
+    }
+    // A cycle with room to spare means unlucky (or adversarial) hash
+    // functions, so pick new seeds. Past that the table has to grow.
+    if (loadFactor() < 1 / (2 * (1 + epsilon_)) and reseeds_ < 3){
+        ++reseeds_;
+        rehash(numBuckets_, true);
+    } else if (loadFactor() < 1 / (4 * (1 + epsilon_))){
+        // Fresh seeds keep failing this far below the limit, so the keys
+        // share std::hash values and doubling would never end. Walk the
+        // evictions back so the map is unchanged, then give up.
+        for (size_t loops = 0; loops < maxLoop_; ++loops){
+            std::swap(newItem, table2_[getHash2(getHash1(newItem.key_)) % numBuckets_]);
+            std::swap(newItem, table1_[getHash1(newItem.key_) % numBuckets_]);
         }
-        // Rehash and insert the new item.
-        rehash(numBuckets_ * 2);
-        insert(newItem.key_, newItem.value_, true);
+        throw std::runtime_error("CuckooHashMap: keys collide under every seed, their std::hash values are likely equal");
+    } else {
+        rehash(numBuckets_ * 2, true);
     }
+    insert(std::move(newItem), updateValues);
     return;
 }
 
@@ -189,10 +553,10 @@ void CuckooHashMap<key_t, value_t>::erase(const key_t& key){
         }
         // Find the new maximum loop size
         --size_;
-        maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_)));
+        maxLoop_ = 3*size_t(ceil(log(std::max(size_, size_t(1))) / log(1 + epsilon_))) + 1;
 
         // Check if resizing is needed. Critical threshold is (1+e)n/4
-        if (downsizeThresh_ > loadFactor())
+        if (downsizeThresh_ > loadFactor() and numBuckets_ > 2)
         {
             rehash(numBuckets_ / 2);
         }
@@ -202,20 +566,99 @@ void CuckooHashMap<key_t, value_t>::erase(const key_t& key){
 
 template <typename key_t, typename value_t>
 value_t& CuckooHashMap<key_t, value_t>::lookup(const key_t& key)  const {
-    // Assume that exists has been called
     size_t hash1 = getHash1(key);
     Item& item1 = table1_[hash1 % numBuckets_];
     if (item1.valid_ and item1.key_ == key)
     {
+        recordHit(item1);
         return item1.value_;
     } else {
         size_t hash2 = getHash2(hash1);
         Item &item2 = table2_[hash2 % numBuckets_];
-        // If the key is not in the table, this is wrong!
+        if (!item2.valid_ or !(item2.key_ == key)){
+            throw std::out_of_range("CuckooHashMap::lookup: key not found");
+        }
+        recordHit(item2);
         return item2.value_;
     }
 }
 
+template <typename key_t, typename value_t>
+CuckooTask<value_t*> CuckooHashMap<key_t, value_t>::lookupAsync(key_t key, CuckooScheduler &scheduler) const {
+    // key is taken by value so it outlives the caller's argument
+    // Both hashes up front so both buckets are in flight while suspended
+    size_t hash1 = getHash1(key);
+    size_t index1 = hash1 % numBuckets_;
+    size_t index2 = getHash2(hash1) % numBuckets_;
+    size_t numBuckets = numBuckets_;
+    size_t seed1 = seed1_;
+    size_t seed2 = seed2_;
+    __builtin_prefetch(&table1_[index1]);
+    __builtin_prefetch(&table2_[index2]);
+    co_await scheduler.yield();
+
+    // Only indices are kept across the suspension, since an insert or erase
+    // may have rehashed into new tables, possibly with new seeds.
+    if (numBuckets != numBuckets_ or seed1 != seed1_ or seed2 != seed2_){
+        hash1 = getHash1(key);
+        index1 = hash1 % numBuckets_;
+        index2 = getHash2(hash1) % numBuckets_;
+    }
+    Item &item1 = table1_[index1];
+    if (item1.valid_ and item1.key_ == key){
+        recordHit(item1);
+        co_return &item1.value_;
+    }
+    Item &item2 = table2_[index2];
+    if (item2.valid_ and item2.key_ == key){
+        recordHit(item2);
+        co_return &item2.value_;
+    }
+    co_return nullptr;
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::recordHit(Item &item) const {
+    if (accessAware_ and item.hits_ < UINT8_MAX){
+        ++item.hits_;
+    }
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::setAccessAware(bool enabled){
+    accessAware_ = enabled;
+}
+
+template <typename key_t, typename value_t>
+void CuckooHashMap<key_t, value_t>::rebalance(){
+    // Pull table 2 items into table 1 when their spot there is free, or held
+    // by a colder item whose own table 2 spot is free (or is this one).
+    for (size_t i = 0; i < numBuckets_; ++i){
+        Item &item2 = table2_[i];
+        if (!item2.valid_){
+            continue;
+        }
+        Item &item1 = table1_[getHash1(item2.key_) % numBuckets_];
+        if (!item1.valid_){
+            std::swap(item1, item2);
+        } else if (item1.hits_ < item2.hits_){
+            Item &alt = table2_[getHash2(getHash1(item1.key_)) % numBuckets_];
+            if (&alt == &item2){
+                std::swap(item1, item2);
+            } else if (!alt.valid_){
+                std::swap(item1, alt);
+                std::swap(item1, item2);
+            }
+        }
+    }
+
+    // Halve the counts so the placement follows recent reads
+    for (size_t i = 0; i < numBuckets_; ++i){
+        table1_[i].hits_ >>= 1;
+        table2_[i].hits_ >>= 1;
+    }
+}
+
 template <typename key_t, typename value_t>
 value_t& CuckooHashMap<key_t, value_t>::operator[](const key_t& key) {
     return lookup(key);
@@ -246,12 +689,61 @@ void CuckooHashMap<key_t, value_t>::printToStream(ostream& out) const {
 }
 
 template <typename key_t, typename value_t>
-CuckooHashMap<key_t, value_t>::Item::Item():valid_{false}{
+void CuckooHashMap<key_t, value_t>::writeSnapshot(ostream& os) const {
+    cuckooWrite(os, uint64_t(numBuckets_));
+    cuckooWrite(os, uint64_t(size_));
+    cuckooWrite(os, uint64_t(seed1_));
+    cuckooWrite(os, uint64_t(seed2_));
+    for (Item *table : {table1_, table2_}){
+        for (Item *item = table; item < table + numBuckets_; ++item){
+            cuckooWrite(os, item->valid_);
+            if (item->valid_){
+                cuckooWrite(os, item->key_);
+                cuckooWrite(os, item->value_);
+            }
+        }
+    }
+}
+
+template <typename key_t, typename value_t>
+bool CuckooHashMap<key_t, value_t>::readSnapshot(istream& is){
+    uint64_t numBuckets, size, seed1, seed2;
+    if (!cuckooRead(is, numBuckets) or !cuckooRead(is, size) or !cuckooRead(is, seed1) or
+        !cuckooRead(is, seed2) or numBuckets < 2){
+        return false;
+    }
+    // Slots go back where they were, so nothing is rehashed
+    Item *tables[2] = {allocateTable(numBuckets), allocateTable(numBuckets)};
+    for (Item *table : tables){
+        for (Item *item = table; item < table + numBuckets; ++item){
+            if (!cuckooRead(is, item->valid_) or
+                (item->valid_ and (!cuckooRead(is, item->key_) or !cuckooRead(is, item->value_)))){
+                freeTable(tables[0], numBuckets);
+                freeTable(tables[1], numBuckets);
+                return false;
+            }
+        }
+    }
+    freeTable(table1_, numBuckets_);
+    freeTable(table2_, numBuckets_);
+    table1_ = tables[0];
+    table2_ = tables[1];
+    numBuckets_ = numBuckets;
+    size_ = size;
+    seed1_ = seed1;
+    seed2_ = seed2;
+    reseeds_ = 0;
+    maxLoop_ = 3*size_t(ceil(log(std::max(size_, size_t(1))) / log(1 + epsilon_))) + 1;
+    return true;
+}
+
+template <typename key_t, typename value_t>
+CuckooHashMap<key_t, value_t>::Item::Item():valid_{false}, hits_{0}{
 }
 
 template <typename key_t, typename value_t>
 CuckooHashMap<key_t, value_t>::Item::Item(key_t& key, value_t& value):
-key_{key}, value_{value},valid_{true}{}
+key_{key}, value_{value},valid_{true}, hits_{0}{}
 
 template <typename key_t, typename value_t>
 ostream& operator<<(ostream& os, const CuckooHashMap<key_t, value_t>& ch){
@@ -330,74 +822,578 @@ typename CuckooHashMap<key_t, value_t>::const_iterator::pointer CuckooHashMap<ke
     return &(**this);
 }
 
-/*******************
- * Cuckoo Hash Set *
- *******************/
+/***************************
+ * Sharded Cuckoo Hash Map *
+ ***************************/
 
-template <typename T>
-CuckooHashSet<T>::CuckooHashSet():valid1_{false, false}, valid2_{false, false},
-    epsilon_{0.4}, size_{0}, table1_{new T[2]}, table2_{new T[2]}, maxLoop_{1},
-    numBuckets_{2}, downsizeThresh_{0.2}{
+template <typename key_t, typename value_t>
+ShardedCuckooHashMap<key_t, value_t>::ShardedCuckooHashMap():ShardedCuckooHashMap(16){
     // Nothing here
 }
 
-template <typename T>
-CuckooHashSet<T>::CuckooHashSet(double epsilon, float downsizeThresh):
-    valid1_{false, false}, valid2_{false, false}, epsilon_{epsilon}, 
-    size_{0}, table1_{new T[2]}, table2_{new T[2]}, maxLoop_{1},
-    numBuckets_{2}, downsizeThresh_{downsizeThresh} {
+template <typename key_t, typename value_t>
+ShardedCuckooHashMap<key_t, value_t>::ShardedCuckooHashMap(size_t numShards):
+    ShardedCuckooHashMap(numShards, 0.4, 0.2){
+    // Nothing here
+}
 
+template <typename key_t, typename value_t>
+ShardedCuckooHashMap<key_t, value_t>::ShardedCuckooHashMap(size_t numShards, double epsilon, float downsizeThresh):
+    shardBits_{0}, seed_{0}{
+    std::random_device rd;
+    seed_ = (uint64_t(rd()) << 32) | rd();
+    // Round up to a power of 2 so the shard is a slice of the hash bits
+    while ((size_t(1) << shardBits_) < numShards){
+        ++shardBits_;
+    }
+    int numNodes = 0;
+#ifdef CUCKOO_HASH_HAS_LIBNUMA
+    if (numa_available() >= 0){
+        numNodes = numa_num_configured_nodes();
+    }
+#endif
+    for (size_t i = 0; i < (size_t(1) << shardBits_); ++i){
+        int node = numNodes > 0 ? int(i % numNodes) : -1;
+        shards_.push_back(std::make_unique<CuckooHashMap<key_t, value_t>>(epsilon, downsizeThresh, node));
+    }
 }
 
-template <typename T>
-CuckooHashSet<T>::~CuckooHashSet(){
-    delete[] table1_;
-    delete[] table2_;
+template <typename key_t, typename value_t>
+size_t ShardedCuckooHashMap<key_t, value_t>::getShard(const key_t& key) const {
+    if (shardBits_ == 0){
+        return 0;
+    }
+    // High bits of a seeded mix, independent of each shard's bucket index
+    return size_t(cuckooMix(uint64_t(hash_(key)) ^ seed_) >> (64 - shardBits_));
 }
 
-template <typename T>
-size_t CuckooHashSet<T>::getHash1(const T& key) const {
-    return hash1_(key);
+template <typename key_t, typename value_t>
+bool ShardedCuckooHashMap<key_t, value_t>::contains(const key_t& key) const {
+    return shards_[getShard(key)]->contains(key);
 }
 
-template <typename T>
-size_t CuckooHashSet<T>::getHash2(size_t hash1) const{
-    string key_str;
-    for (size_t byte = 0; byte < 8; ++byte)
-    {
-        unsigned char c = hash1 & 255;
-        key_str += c;
-        hash1 >>= 8;
+template <typename key_t, typename value_t>
+void ShardedCuckooHashMap<key_t, value_t>::insert(const key_t& key, const value_t& value){
+    shards_[getShard(key)]->insert(key, value);
+}
+
+template <typename key_t, typename value_t>
+void ShardedCuckooHashMap<key_t, value_t>::erase(const key_t& key){
+    shards_[getShard(key)]->erase(key);
+}
+
+template <typename key_t, typename value_t>
+value_t& ShardedCuckooHashMap<key_t, value_t>::lookup(const key_t& key) const {
+    return shards_[getShard(key)]->lookup(key);
+}
+
+template <typename key_t, typename value_t>
+value_t& ShardedCuckooHashMap<key_t, value_t>::operator[](const key_t& key) {
+    return lookup(key);
+}
+
+template <typename key_t, typename value_t>
+void ShardedCuckooHashMap<key_t, value_t>::clear(){
+    for (auto &shard : shards_){
+        shard->clear();
     }
-    return  hash2_(key_str);
 }
 
-template <typename T>
-double CuckooHashSet<T>::loadFactor() const {
-    return double(size_) / (2 * numBuckets_);
+template <typename key_t, typename value_t>
+bool ShardedCuckooHashMap<key_t, value_t>::empty() const {
+    return size() == 0;
 }
 
-template <typename T>
-void CuckooHashSet<T>::rehash(size_t numBuckets){
-    vector<T> allKeys;
-    for (size_t i = 0; i < numBuckets_;++i)
-    {
-        if (valid1_[i]){
-            allKeys.push_back(table1_[i]);
-        }
+template <typename key_t, typename value_t>
+size_t ShardedCuckooHashMap<key_t, value_t>::size() const {
+    size_t total = 0;
+    for (const auto &shard : shards_){
+        total += shard->size();
     }
-    for (size_t i = 0; i < numBuckets_;++i)
-    {
-        if (valid2_[i]){
-            allKeys.push_back(table2_[i]);
-        }
+    return total;
+}
+
+template <typename key_t, typename value_t>
+double ShardedCuckooHashMap<key_t, value_t>::loadFactor() const {
+    double total = 0;
+    for (const auto &shard : shards_){
+        total += shard->loadFactor();
     }
+    return total / shards_.size();
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedCuckooHashMap<key_t, value_t>::numShards() const {
+    return shards_.size();
+}
+
+template <typename key_t, typename value_t>
+const CuckooHashMap<key_t, value_t>& ShardedCuckooHashMap<key_t, value_t>::shard(size_t idx) const {
+    return *shards_[idx];
+}
+
+template <typename key_t, typename value_t>
+void ShardedCuckooHashMap<key_t, value_t>::printToStream(ostream& out) const {
+    for (size_t i = 0; i < shards_.size(); ++i){
+        out << "Shard " << i << ":\n" << *shards_[i] << "\n";
+    }
+}
+
+template <typename key_t, typename value_t>
+ostream& operator<<(ostream& os, const ShardedCuckooHashMap<key_t, value_t>& sh){
+    sh.printToStream(os);
+    return os;
+}
+
+#ifdef CUCKOO_HASH_HAS_POSIX
+
+/******************************
+ * Persistent Cuckoo Hash Map *
+ ******************************/
+
+template <typename key_t, typename value_t>
+PersistentCuckooHashMap<key_t, value_t>::PersistentCuckooHashMap(const string& path):
+    PersistentCuckooHashMap(path, 1 << 16, 1 << 20){
+    // Nothing here
+}
+
+template <typename key_t, typename value_t>
+PersistentCuckooHashMap<key_t, value_t>::PersistentCuckooHashMap(const string& path, size_t groupBytes, size_t checkpointOps):
+    logPath_{path + ".log"}, checkpointPath_{path + ".ckpt"}, logFd_{-1},
+    groupBytes_{groupBytes}, checkpointOps_{checkpointOps}, opsSinceCheckpoint_{0}{
+    recover();
+}
+
+template <typename key_t, typename value_t>
+PersistentCuckooHashMap<key_t, value_t>::~PersistentCuckooHashMap(){
+    try {
+        sync();
+    } catch (const std::exception &) {
+        // Nothing to do, the log is as durable as it could be made
+    }
+    if (logFd_ >= 0){
+        ::close(logFd_);
+    }
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::openLog(bool truncate){
+    if (logFd_ >= 0){
+        ::close(logFd_);
+    }
+    logFd_ = ::open(logPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    if (logFd_ < 0){
+        throw std::runtime_error("PersistentCuckooHashMap: can't open " + logPath_);
+    }
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::recover(){
+    ifstream checkpointFile(checkpointPath_, std::ios::binary);
+    if (checkpointFile and !map_.readSnapshot(checkpointFile)){
+        throw std::runtime_error("PersistentCuckooHashMap: corrupt checkpoint " + checkpointPath_);
+    }
+
+    // Replay records until the end of the log or the first torn record
+    ifstream logFile(logPath_, std::ios::binary | std::ios::ate);
+    off_t logBytes = logFile ? off_t(logFile.tellg()) : 0;
+    logFile.seekg(0);
+    off_t validBytes = 0;
+    uint32_t length, checksum;
+    while (cuckooRead(logFile, length) and cuckooRead(logFile, checksum)){
+        // A torn length can be garbage, so check it before allocating
+        off_t headerBytes = sizeof(length) + sizeof(checksum);
+        if (off_t(length) > logBytes - validBytes - headerBytes){
+            break;
+        }
+        string record(length, '\0');
+        if (!logFile.read(record.data(), length) or cuckooChecksum(record) != checksum){
+            break;
+        }
+        istringstream fields(record);
+        uint8_t op;
+        key_t key;
+        value_t value;
+        cuckooRead(fields, op);
+        if (Op(op) == Op::Clear){
+            map_.clear();
+        } else if (!cuckooRead(fields, key)){
+            // Checksummed, so only an unknown record could be this short
+        } else if (Op(op) == Op::Insert and cuckooRead(fields, value)){
+            map_.insert(key, value);
+        } else if (Op(op) == Op::Erase){
+            map_.erase(key);
+        }
+        validBytes += sizeof(length) + sizeof(checksum) + length;
+        ++opsSinceCheckpoint_;
+    }
+
+    // Drop a torn tail so new records follow the last good one
+    openLog(false);
+    if (::ftruncate(logFd_, validBytes) != 0){
+        throw std::runtime_error("PersistentCuckooHashMap: can't truncate " + logPath_);
+    }
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::append(Op op, const key_t* key, const value_t* value){
+    ostringstream fields;
+    cuckooWrite(fields, uint8_t(op));
+    if (key){
+        cuckooWrite(fields, *key);
+    }
+    if (value){
+        cuckooWrite(fields, *value);
+    }
+    string record = fields.str();
+    uint32_t length = record.size();
+    uint32_t checksum = cuckooChecksum(record);
+    buffer_.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    buffer_.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    buffer_ += record;
+
+    if (buffer_.size() >= groupBytes_){
+        sync();
+    }
+    if (++opsSinceCheckpoint_ >= checkpointOps_){
+        checkpoint();
+    }
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::sync(){
+    size_t written = 0;
+    while (written < buffer_.size()){
+        ssize_t n = ::write(logFd_, buffer_.data() + written, buffer_.size() - written);
+        if (n < 0){
+            throw std::runtime_error("PersistentCuckooHashMap: can't write " + logPath_);
+        }
+        written += n;
+    }
+    if (written > 0 and ::fsync(logFd_) != 0){
+        throw std::runtime_error("PersistentCuckooHashMap: can't fsync " + logPath_);
+    }
+    buffer_.clear();
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::checkpoint(){
+    sync();
+    string tmpPath = checkpointPath_ + ".tmp";
+    {
+        ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        map_.writeSnapshot(out);
+        if (!out.flush()){
+            throw std::runtime_error("PersistentCuckooHashMap: can't write " + tmpPath);
+        }
+    }
+    int fd = ::open(tmpPath.c_str(), O_RDONLY);
+    if (fd < 0 or ::fsync(fd) != 0){
+        throw std::runtime_error("PersistentCuckooHashMap: can't fsync " + tmpPath);
+    }
+    ::close(fd);
+    if (std::rename(tmpPath.c_str(), checkpointPath_.c_str()) != 0){
+        throw std::runtime_error("PersistentCuckooHashMap: can't rename " + tmpPath);
+    }
+    size_t slash = checkpointPath_.rfind('/');
+    string dir = slash == string::npos ? "." : checkpointPath_.substr(0, slash + 1);
+    int dirFd = ::open(dir.c_str(), O_RDONLY);
+    if (dirFd >= 0){
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+
+    // A crash before this point replays the old log over the new checkpoint.
+    // Replaying inserts and erases in order ends in the same state, but that
+    // doesn't hold for clear, which logs its own record for that reason.
+    openLog(true);
+    opsSinceCheckpoint_ = 0;
+}
+
+template <typename key_t, typename value_t>
+bool PersistentCuckooHashMap<key_t, value_t>::contains(const key_t& key) const {
+    return map_.contains(key);
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::insert(const key_t& key, const value_t& value){
+    map_.insert(key, value);
+    append(Op::Insert, &key, &value);
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::erase(const key_t& key){
+    map_.erase(key);
+    append(Op::Erase, &key, nullptr);
+}
+
+template <typename key_t, typename value_t>
+const value_t& PersistentCuckooHashMap<key_t, value_t>::lookup(const key_t& key) const {
+    return map_.lookup(key);
+}
+
+template <typename key_t, typename value_t>
+void PersistentCuckooHashMap<key_t, value_t>::clear(){
+    // The record must be durable before the empty checkpoint replaces the
+    // old one, or a crash before the log is truncated brings the keys back
+    buffer_.clear();
+    map_.clear();
+    append(Op::Clear, nullptr, nullptr);
+    sync();
+    checkpoint();
+}
+
+template <typename key_t, typename value_t>
+bool PersistentCuckooHashMap<key_t, value_t>::empty() const {
+    return map_.empty();
+}
+
+template <typename key_t, typename value_t>
+size_t PersistentCuckooHashMap<key_t, value_t>::size() const {
+    return map_.size();
+}
+
+template <typename key_t, typename value_t>
+double PersistentCuckooHashMap<key_t, value_t>::loadFactor() const {
+    return map_.loadFactor();
+}
+
+template <typename key_t, typename value_t>
+const CuckooHashMap<key_t, value_t>& PersistentCuckooHashMap<key_t, value_t>::map() const {
+    return map_;
+}
+
+#endif // CUCKOO_HASH_HAS_POSIX
+
+/***********************
+ * RCU Cuckoo Hash Map *
+ ***********************/
+
+template <typename key_t, typename value_t>
+RcuCuckooHashMap<key_t, value_t>::RcuCuckooHashMap():
+    current_{new map_t()}, epoch_{0}, slots_{new Slot[maxReaders_]}{
+    // Nothing here
+}
+
+template <typename key_t, typename value_t>
+RcuCuckooHashMap<key_t, value_t>::~RcuCuckooHashMap(){
+    for (Retired &retired : retired_){
+        delete retired.map_;
+    }
+    delete current_.load();
+}
+
+template <typename key_t, typename value_t>
+template <typename F>
+void RcuCuckooHashMap<key_t, value_t>::update(F f){
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    // Owned here until published, so a throwing f doesn't leak the copy
+    auto copy = std::make_unique<map_t>(*current_.load());
+    f(*copy);
+    publish(std::move(copy));
+}
+
+template <typename key_t, typename value_t>
+void RcuCuckooHashMap<key_t, value_t>::publish(std::unique_ptr<const map_t> map){
+    retired_.reserve(retired_.size() + 1); // Can't throw after the exchange
+    const map_t* old = current_.exchange(map.release());
+    // A reader that saw old announced an epoch no later than this one
+    retired_.push_back({old, epoch_.fetch_add(1)});
+    reclaim();
+}
+
+template <typename key_t, typename value_t>
+void RcuCuckooHashMap<key_t, value_t>::reclaim(){
+    uint64_t oldest = idleSlot_;
+    for (size_t i = 0; i < maxReaders_; ++i){
+        oldest = std::min(oldest, slots_[i].epoch_.load());
+    }
+    // Versions retired before the oldest active reader's epoch are unreachable
+    auto unreachable = [oldest](const Retired &retired){
+        if (retired.epoch_ < oldest){
+            delete retired.map_;
+            return true;
+        }
+        return false;
+    };
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(), unreachable), retired_.end());
+}
+
+template <typename key_t, typename value_t>
+void RcuCuckooHashMap<key_t, value_t>::insert(const key_t& key, const value_t& value){
+    update([&](map_t &map){ map.insert(key, value); });
+}
+
+template <typename key_t, typename value_t>
+void RcuCuckooHashMap<key_t, value_t>::erase(const key_t& key){
+    update([&](map_t &map){ map.erase(key); });
+}
+
+template <typename key_t, typename value_t>
+void RcuCuckooHashMap<key_t, value_t>::clear(){
+    update([](map_t &map){ map.clear(); });
+}
+
+template <typename key_t, typename value_t>
+void RcuCuckooHashMap<key_t, value_t>::synchronize(){
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    while (!retired_.empty()){
+        std::this_thread::yield();
+        reclaim();
+    }
+}
+
+template <typename key_t, typename value_t>
+typename RcuCuckooHashMap<key_t, value_t>::Reader RcuCuckooHashMap<key_t, value_t>::reader(){
+    return Reader(*this);
+}
+
+template <typename key_t, typename value_t>
+RcuCuckooHashMap<key_t, value_t>::Reader::Reader(RcuCuckooHashMap &rcu):rcu_{rcu}, slot_{nullptr}{
+    for (size_t i = 0; i < maxReaders_; ++i){
+        uint64_t expected = freeSlot_;
+        if (rcu_.slots_[i].epoch_.compare_exchange_strong(expected, idleSlot_)){
+            slot_ = &rcu_.slots_[i];
+            return;
+        }
+    }
+    throw std::runtime_error("RcuCuckooHashMap: too many readers");
+}
+
+template <typename key_t, typename value_t>
+RcuCuckooHashMap<key_t, value_t>::Reader::~Reader(){
+    slot_->epoch_.store(freeSlot_);
+}
+
+template <typename key_t, typename value_t>
+template <typename F>
+auto RcuCuckooHashMap<key_t, value_t>::Reader::read(F f){
+    // Announce the epoch before loading the version, so a writer that
+    // retires this version sees the announcement. Wait free: no loops.
+    slot_->epoch_.store(rcu_.epoch_.load());
+    struct Leave {
+        Slot *slot_;
+        ~Leave() { slot_->epoch_.store(idleSlot_); }
+    } leave{slot_};
+    return f(*rcu_.current_.load());
+}
+
+template <typename key_t, typename value_t>
+bool RcuCuckooHashMap<key_t, value_t>::Reader::contains(const key_t& key){
+    return read([&key](const map_t &map){ return map.contains(key); });
+}
+
+template <typename key_t, typename value_t>
+value_t RcuCuckooHashMap<key_t, value_t>::Reader::lookup(const key_t& key){
+    // Returns a copy, the version may be freed once the read ends
+    return read([&key](const map_t &map){ return map.lookup(key); });
+}
+
+/*******************
+ * Cuckoo Hash Set *
+ *******************/
+
+template <typename T>
+CuckooHashSet<T>::CuckooHashSet():valid1_{false, false}, valid2_{false, false},
+    epsilon_{0.4}, size_{0}, table1_{new T[2]}, table2_{new T[2]}, maxLoop_{1},
+    numBuckets_{2}, seed1_{randomSeed()}, seed2_{randomSeed()}, reseeds_{0}, fixedSeeds_{false}, seedState_{0},
+    downsizeThresh_{0.2},
+    peakResizeBytes_{0}{
+    // Nothing here
+}
+
+template <typename T>
+CuckooHashSet<T>::CuckooHashSet(double epsilon, float downsizeThresh):
+    valid1_{false, false}, valid2_{false, false}, epsilon_{epsilon}, 
+    size_{0}, table1_{new T[2]}, table2_{new T[2]}, maxLoop_{1},
+    numBuckets_{2}, seed1_{randomSeed()}, seed2_{randomSeed()}, reseeds_{0}, fixedSeeds_{false}, seedState_{0},
+    downsizeThresh_{downsizeThresh},
+    peakResizeBytes_{0} {
+
+}
+
+template <typename T>
+CuckooHashSet<T>::~CuckooHashSet(){
+    delete[] table1_;
+    delete[] table2_;
+}
+
+template <typename T>
+size_t CuckooHashSet<T>::randomSeed() {
+    static std::random_device rd;
+    return size_t((uint64_t(rd()) << 32) | rd());
+}
+
+template <typename T>
+size_t CuckooHashSet<T>::nextSeed() {
+    if (fixedSeeds_){
+        // splitmix64 stream, so a run can be replayed from its seed
+        seedState_ += 0x9E3779B97F4A7C15ULL;
+        return size_t(cuckooMix(seedState_));
+    }
+    return randomSeed();
+}
+
+template <typename T>
+size_t CuckooHashSet<T>::getHash1(const T& key) const {
+    // Mix the seed in so bucket indices can't be predicted from std::hash
+    return size_t(cuckooMix(uint64_t(hash1_(key)) ^ seed1_));
+}
+
+template <typename T>
+size_t CuckooHashSet<T>::getHash2(size_t hash1) const{
+    string key_str;
+    hash1 ^= seed2_;
+    for (size_t byte = 0; byte < 8; ++byte)
+    {
+        unsigned char c = hash1 & 255;
+        key_str += c;
+        hash1 >>= 8;
+    }
+    return  hash2_(key_str);
+}
+
+template <typename T>
+double CuckooHashSet<T>::loadFactor() const {
+    return double(size_) / (2 * numBuckets_);
+}
+
+template <typename T>
+void CuckooHashSet<T>::rehash(size_t numBuckets){
+    rehash(numBuckets, false);
+}
+
+template <typename T>
+void CuckooHashSet<T>::rehash(size_t numBuckets, bool reseed){
+    if (reseed){
+        seed1_ = nextSeed();
+        seed2_ = nextSeed();
+    }
+    vector<T> allKeys;
+    allKeys.reserve(size_);
+    for (size_t i = 0; i < numBuckets_;++i)
+    {
+        if (valid1_[i]){
+            allKeys.push_back(std::move(table1_[i]));
+        }
+    }
+    for (size_t i = 0; i < numBuckets_;++i)
+    {
+        if (valid2_[i]){
+            allKeys.push_back(std::move(table2_[i]));
+        }
+    }
+    size_t tableBytes = 2 * std::max(numBuckets, numBuckets_) * sizeof(T);
+    peakResizeBytes_ = std::max(peakResizeBytes_, tableBytes + allKeys.capacity() * sizeof(T));
 
     // Clear old tables
     delete[] table1_;
     delete[] table2_;
 
     // Rehash into new table;
+    if (numBuckets != numBuckets_){
+        reseeds_ = 0;
+    }
     numBuckets_ = numBuckets;
     table1_ = new T[numBuckets_];
     table2_ = new T[numBuckets_];
@@ -406,56 +1402,106 @@ void CuckooHashSet<T>::rehash(size_t numBuckets){
     std::fill(valid1_.begin(), valid1_.end(), false);
     std::fill(valid2_.begin(), valid2_.end(), false);
 
-    // Re-insert all items
-    for (const T& key : allKeys)
+    // Re-insert all items, moved since the keys are already unique
+    for (T& key : allKeys)
     {
-        insert(key, false);
+        insertNew(std::move(key), false);
+    }
+}
+
+template <typename T>
+CuckooMemoryUsage CuckooHashSet<T>::memoryUsage() const {
+    CuckooMemoryUsage usage{};
+    usage.slotBytes = 2 * numBuckets_ * sizeof(T);
+    usage.metadataBytes = sizeof(*this) + (valid1_.capacity() + valid2_.capacity()) / 8;
+    for (size_t i = 0; i < numBuckets_; ++i){
+        usage.heapBytes += valid1_[i] ? cuckooHeapBytes(table1_[i]) : 0;
+        usage.heapBytes += valid2_[i] ? cuckooHeapBytes(table2_[i]) : 0;
     }
+    usage.peakResizeBytes = peakResizeBytes_;
+    return usage;
+}
+
+template <typename T>
+void CuckooHashSet<T>::compact(double targetLoad){
+    if (!(targetLoad > 0)){
+        throw std::invalid_argument("CuckooHashSet: compact needs a positive target load");
+    }
+    // Above this, failed insertion cycles double the table again
+    targetLoad = std::min(targetLoad, 1 / (2 * (1 + epsilon_)));
+    size_t numBuckets = size_t(ceil(size_ / (2 * targetLoad)));
+    rehash(std::max(numBuckets, size_t(2)));
+}
+
+template <typename T>
+void CuckooHashSet<T>::reseed(){
+    rehash(numBuckets_, true);
+}
+
+template <typename T>
+void CuckooHashSet<T>::seed(uint64_t seed){
+    fixedSeeds_ = true;
+    seedState_ = seed;
+    rehash(numBuckets_, true);
 }
 
 template<typename T>
 void CuckooHashSet<T>::insert(const T&key, bool updateValues){
-    T keyCopy = key;
-    T newKey = key;
     if (contains(key))
     {
         return;
     }
-    else
-    {
-        for (size_t loops = 0; loops < maxLoop_; ++loops){
-            size_t h1 = getHash1(newKey);
-            // Empty spot, insert and finish
-            if (!valid1_[h1%numBuckets_]){
-                table1_[h1%numBuckets_] = newKey;
-                valid1_[h1 % numBuckets_] = true;
-                if (updateValues)
-                {
-                    ++size_;
-                    maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
-                }
-                return;
-            } else {
-                std::swap(newKey, table1_[h1 % numBuckets_]);
+    insertNew(key, updateValues);
+}
+
+template<typename T>
+void CuckooHashSet<T>::insertNew(T newKey, bool updateValues){
+    for (size_t loops = 0; loops < maxLoop_; ++loops){
+        size_t h1 = getHash1(newKey);
+        // Empty spot, insert and finish
+        if (!valid1_[h1%numBuckets_]){
+            table1_[h1%numBuckets_] = std::move(newKey);
+            valid1_[h1 % numBuckets_] = true;
+            if (updateValues)
+            {
+                ++size_;
+                maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
             }
-            size_t h2 = getHash2(getHash1(newKey)); // This is slow!
-            if (!valid2_[h2 % numBuckets_]){
-                table2_[h2 % numBuckets_] = newKey;
-                valid2_[h2 % numBuckets_] = true;
-                if(updateValues){
-                    ++size_;
-                    maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
-                }
-                return;
-            } else {
-                std::swap(newKey, table2_[h2 % numBuckets_]);
+            return;
+        } else {
+            std::swap(newKey, table1_[h1 % numBuckets_]);
+        }
+        size_t h2 = getHash2(getHash1(newKey)); // This is slow!
+        if (!valid2_[h2 % numBuckets_]){
+            table2_[h2 % numBuckets_] = std::move(newKey);
+            valid2_[h2 % numBuckets_] = true;
+            if(updateValues){
+                ++size_;
+                maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_))) + 1;
             }
+            return;
+        } else {
+            std::swap(newKey, table2_[h2 % numBuckets_]);
         }
-        // Rehash and insert the new item.
-        rehash(numBuckets_ * 2);
-        insert(newKey, true);
     }
-    return;
+    // A cycle with room to spare means unlucky (or adversarial) hash
+    // functions, so pick new seeds. Past that the table has to grow.
+    if (loadFactor() < 1 / (2 * (1 + epsilon_)) and reseeds_ < 3){
+        ++reseeds_;
+        rehash(numBuckets_, true);
+    } else if (loadFactor() < 1 / (4 * (1 + epsilon_))){
+        // Fresh seeds keep failing this far below the limit, so the keys
+        // share std::hash values and doubling would never end. Walk the
+        // evictions back so the set is unchanged, then give up.
+        for (size_t loops = 0; loops < maxLoop_; ++loops){
+            std::swap(newKey, table2_[getHash2(getHash1(newKey)) % numBuckets_]);
+            std::swap(newKey, table1_[getHash1(newKey) % numBuckets_]);
+        }
+        throw std::runtime_error("CuckooHashSet: keys collide under every seed, their std::hash values are likely equal");
+    } else {
+        rehash(numBuckets_ * 2, true);
+    }
+    insertNew(std::move(newKey), updateValues);
 }
 
 template<typename T>
@@ -465,7 +1511,7 @@ bool CuckooHashSet<T>::empty() const {
 
 template <typename T>
 size_t CuckooHashSet<T>::size() const {
-    return size_ == 0;
+    return size_;
 }
 
 template <typename T>
@@ -491,10 +1537,10 @@ void CuckooHashSet<T>::erase(const T& key){
         }
         // Find the new maximum loop size
         --size_;
-        maxLoop_ = 3*size_t(ceil(log(size_) / log(1 + epsilon_)));
+        maxLoop_ = 3*size_t(ceil(log(std::max(size_, size_t(1))) / log(1 + epsilon_))) + 1;
 
         // Check if resizing is needed. Critical threshold is (1+e)n/4
-        if (downsizeThresh_ > loadFactor())
+        if (downsizeThresh_ > loadFactor() and numBuckets_ > 2)
         {
             rehash(numBuckets_ / 2);
         }
@@ -526,6 +1572,7 @@ void CuckooHashSet<T>::clear(){
     numBuckets_ = 2;
     maxLoop_ = 1;
     size_ = 0;
+    reseeds_ = 0;
 }
 
 template <typename T>
@@ -627,3 +1674,415 @@ ostream& operator<<(ostream& os, const CuckooHashSet<T>& cs){
     cs.printToStream(os);
     return os;
 }
+
+/*****************
+ * Cuckoo Filter *
+ *****************/
+
+template <typename T>
+CuckooFilter<T>::Table::Table(size_t numBuckets, size_t fingerprintBits):
+    bits_((numBuckets * slotsPerBucket_ * fingerprintBits + 7) / 8 + 2, 0),
+    numBuckets_{numBuckets}, size_{0}, maxLoop_{1}{
+    // 2 extra bytes so a slot can always be read as 3 whole bytes
+}
+
+template <typename T>
+CuckooFilter<T>::CuckooFilter():CuckooFilter(0.01, 1024){
+    // Nothing here
+}
+
+template <typename T>
+CuckooFilter<T>::CuckooFilter(double falsePositiveRate, size_t capacity):
+    epsilon_{0.4}, falsePositiveRate_{falsePositiveRate}, size_{0}, kickCounter_{0}{
+    // A lookup checks 2 buckets of slotsPerBucket_ fingerprints, so the
+    // false positive rate is about 2b / 2^f for f fingerprint bits.
+    double bits = ceil(log2(2 * slotsPerBucket_ / falsePositiveRate));
+    fingerprintBits_ = size_t(std::clamp(bits, 1.0, 16.0));
+    addTable(size_t(ceil(capacity / (slotsPerBucket_ * maxLoad_))));
+}
+
+template <typename T>
+void CuckooFilter<T>::addTable(size_t numBuckets){
+    if (tables_.size() == maxTables_){
+        throw std::length_error("CuckooFilter: too many keys for the requested capacity");
+    }
+    // Partial key cuckoo hashing xors indices, so round up to a power of 2
+    size_t powerOf2 = 1;
+    while (powerOf2 < numBuckets){
+        powerOf2 <<= 1;
+    }
+    tables_.emplace_back(powerOf2, fingerprintBits_);
+}
+
+template <typename T>
+uint64_t CuckooFilter<T>::getHash1(const T& key) const {
+    // Mixed so keys differing only in high bits still spread over buckets
+    return cuckooMix(hash1_(key));
+}
+
+template <typename T>
+typename CuckooFilter<T>::fingerprint_t CuckooFilter<T>::getFingerprint(uint64_t hash1) const {
+    // Buckets use the low bits, so take the fingerprint from the top bits
+    fingerprint_t fp = fingerprint_t(hash1 >> (64 - fingerprintBits_));
+    return fp == 0 ? 1 : fp;
+}
+
+template <typename T>
+size_t CuckooFilter<T>::getAltIndex(size_t index, fingerprint_t fp, size_t numBuckets) const {
+    // Symmetric: the alternate of the alternate index is the original index
+    return (index ^ (size_t(fp) * 0x5bd1e995)) & (numBuckets - 1);
+}
+
+template <typename T>
+typename CuckooFilter<T>::fingerprint_t CuckooFilter<T>::getSlot(const Table &table, size_t slot) const {
+    // A slot of at most 16 bits spans at most 3 bytes
+    size_t bit = slot * fingerprintBits_;
+    const uint8_t *bytes = table.bits_.data() + bit / 8;
+    uint32_t word = bytes[0] | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16);
+    return fingerprint_t((word >> (bit % 8)) & ((1u << fingerprintBits_) - 1));
+}
+
+template <typename T>
+void CuckooFilter<T>::setSlot(Table &table, size_t slot, fingerprint_t fp) const {
+    size_t bit = slot * fingerprintBits_;
+    uint8_t *bytes = table.bits_.data() + bit / 8;
+    uint32_t word = bytes[0] | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16);
+    uint32_t mask = ((1u << fingerprintBits_) - 1) << (bit % 8);
+    word = (word & ~mask) | (uint32_t(fp) << (bit % 8));
+    bytes[0] = uint8_t(word);
+    bytes[1] = uint8_t(word >> 8);
+    bytes[2] = uint8_t(word >> 16);
+}
+
+template <typename T>
+bool CuckooFilter<T>::bucketInsert(Table &table, size_t index, fingerprint_t fp){
+    for (size_t slot = index * slotsPerBucket_; slot < (index + 1) * slotsPerBucket_; ++slot){
+        if (getSlot(table, slot) == 0){
+            setSlot(table, slot, fp);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+bool CuckooFilter<T>::bucketContains(const Table &table, size_t index, fingerprint_t fp) const {
+    for (size_t slot = index * slotsPerBucket_; slot < (index + 1) * slotsPerBucket_; ++slot){
+        if (getSlot(table, slot) == fp){
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+bool CuckooFilter<T>::bucketErase(Table &table, size_t index, fingerprint_t fp){
+    for (size_t slot = index * slotsPerBucket_; slot < (index + 1) * slotsPerBucket_; ++slot){
+        if (getSlot(table, slot) == fp){
+            setSlot(table, slot, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+size_t CuckooFilter<T>::bucketCount(const Table &table, size_t index, fingerprint_t fp) const {
+    size_t count = 0;
+    for (size_t slot = index * slotsPerBucket_; slot < (index + 1) * slotsPerBucket_; ++slot){
+        count += getSlot(table, slot) == fp;
+    }
+    return count;
+}
+
+template <typename T>
+bool CuckooFilter<T>::insert(Table &table, uint64_t hash1, fingerprint_t fp){
+    size_t index = hash1 & (table.numBuckets_ - 1);
+    if (bucketInsert(table, index, fp) or bucketInsert(table, getAltIndex(index, fp, table.numBuckets_), fp)){
+        return true;
+    }
+
+    // Both buckets full, start kicking out fingerprints
+    vector<size_t> path;
+    for (size_t loops = 0; loops < table.maxLoop_; ++loops){
+        size_t slot = index * slotsPerBucket_ + (kickCounter_++ % slotsPerBucket_);
+        fingerprint_t evicted = getSlot(table, slot);
+        setSlot(table, slot, fp);
+        fp = evicted;
+        path.push_back(slot);
+        index = getAltIndex(index, fp, table.numBuckets_);
+        if (bucketInsert(table, index, fp)){
+            return true;
+        }
+    }
+
+    // A fingerprint's original hash is gone, so the evictions are undone
+    // instead of leaving a victim that can't be placed in a new table.
+    for (auto slot = path.rbegin(); slot != path.rend(); ++slot){
+        fingerprint_t evicted = getSlot(table, *slot);
+        setSlot(table, *slot, fp);
+        fp = evicted;
+    }
+    return false;
+}
+
+template <typename T>
+void CuckooFilter<T>::insert(const T& key){
+    uint64_t hash1 = getHash1(key);
+    fingerprint_t fp = getFingerprint(hash1);
+    if (!insert(tables_.back(), hash1, fp)) [[unlikely]]{
+        // A bigger table can't help when both buckets hold nothing but this
+        // fingerprint, it would only be filled by the next 8 copies as well
+        Table &back = tables_.back();
+        size_t index = hash1 & (back.numBuckets_ - 1);
+        size_t altIndex = getAltIndex(index, fp, back.numBuckets_);
+        size_t copies = bucketCount(back, index, fp);
+        size_t slots = slotsPerBucket_;
+        if (altIndex != index){
+            copies += bucketCount(back, altIndex, fp);
+            slots += slotsPerBucket_;
+        }
+        if (copies == slots){
+            throw std::length_error("CuckooFilter: a key's buckets are full of its own copies, use insertIfAbsent for repeated keys");
+        }
+        addTable(back.numBuckets_ * 2);
+        insert(tables_.back(), hash1, fp);
+    }
+    Table &table = tables_.back();
+    ++table.size_;
+    table.maxLoop_ = 3*size_t(ceil(log(table.size_) / log(1 + epsilon_))) + 1;
+    ++size_;
+}
+
+template <typename T>
+bool CuckooFilter<T>::insertIfAbsent(const T& key){
+    if (contains(key)){
+        return false;
+    }
+    insert(key);
+    return true;
+}
+
+template <typename T>
+bool CuckooFilter<T>::contains(const T& key) const {
+    uint64_t hash1 = getHash1(key);
+    fingerprint_t fp = getFingerprint(hash1);
+    for (const Table &table : tables_){
+        size_t index = hash1 & (table.numBuckets_ - 1);
+        if (bucketContains(table, index, fp) or
+            bucketContains(table, getAltIndex(index, fp, table.numBuckets_), fp)){
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+bool CuckooFilter<T>::erase(const T& key){
+    // Only erase keys that were inserted, otherwise a colliding key is removed
+    uint64_t hash1 = getHash1(key);
+    fingerprint_t fp = getFingerprint(hash1);
+    for (Table &table : tables_){
+        size_t index = hash1 & (table.numBuckets_ - 1);
+        if (bucketErase(table, index, fp) or
+            bucketErase(table, getAltIndex(index, fp, table.numBuckets_), fp)){
+            --table.size_;
+            --size_;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void CuckooFilter<T>::clear(){
+    size_t numBuckets = tables_.front().numBuckets_;
+    tables_.clear();
+    tables_.emplace_back(numBuckets, fingerprintBits_);
+    size_ = 0;
+}
+
+template <typename T>
+bool CuckooFilter<T>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T>
+size_t CuckooFilter<T>::size() const {
+    return size_;
+}
+
+template <typename T>
+double CuckooFilter<T>::loadFactor() const {
+    size_t numSlots = 0;
+    for (const Table &table : tables_){
+        numSlots += table.numBuckets_ * slotsPerBucket_;
+    }
+    return double(size_) / numSlots;
+}
+
+template <typename T>
+double CuckooFilter<T>::falsePositiveRate() const {
+    // Every extra table is one more pair of buckets a lookup can collide in
+    return tables_.size() * 2 * slotsPerBucket_ / pow(2.0, fingerprintBits_);
+}
+
+template <typename T>
+void CuckooFilter<T>::printToStream(ostream &out) const{
+    out << "Tables: [ ";
+    for (const Table &table : tables_){
+        out << "(" << table.size_ << "/" << table.numBuckets_ * slotsPerBucket_ << ") ";
+    }
+    out << "]\n Fingerprint Bits: " << fingerprintBits_ << " Size: " << size_
+        << " False Positive Rate: " << falsePositiveRate();
+}
+
+template <typename T>
+ostream& operator<<(ostream& os, const CuckooFilter<T>& cf){
+    cf.printToStream(os);
+    return os;
+}
+
+/*********************
+ * Static Cuckoo Map *
+ *********************/
+
+template <typename key_t, typename value_t, size_t N>
+constexpr StaticCuckooMap<key_t, value_t, N>::StaticCuckooMap(std::initializer_list<std::pair<key_t, value_t>> items):
+    table1_{}, table2_{}, filler_{}, seed1_{0}, seed2_{0}{
+    if (items.size() != N){
+        throw std::invalid_argument("StaticCuckooMap: wrong number of items");
+    }
+    // Try seeds until every key has a collision free spot in one of the tables
+    for (uint64_t attempt = 0; attempt < maxSeeds_; ++attempt){
+        seed1_ = 2 * attempt + 1;
+        seed2_ = 2 * attempt + 2;
+        if (place(items)){
+            return;
+        }
+    }
+    throw std::invalid_argument("StaticCuckooMap: no collision free seeds found");
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr uint64_t StaticCuckooMap<key_t, value_t, N>::hash(const key_t& key, uint64_t seed){
+    uint64_t h = seed * 0x9E3779B97F4A7C15ULL;
+    if constexpr (std::is_integral_v<key_t>){
+        h ^= uint64_t(key);
+    } else {
+        // FNV-1a over the characters
+        for (char c : std::string_view(key)){
+            h = (h ^ (unsigned char)c) * 0x100000001B3ULL;
+        }
+    }
+    // splitmix64 finalizer
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr bool StaticCuckooMap<key_t, value_t, N>::keyEqual(const key_t& a, const key_t& b){
+    // Compare characters, not addresses, when keys are const char*
+    if constexpr (std::is_integral_v<key_t>){
+        return a == b;
+    } else {
+        return std::string_view(a) == std::string_view(b);
+    }
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr size_t StaticCuckooMap<key_t, value_t, N>::getHash1(const key_t& key) const {
+    return hash(key, seed1_) & (numBuckets_ - 1);
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr size_t StaticCuckooMap<key_t, value_t, N>::getHash2(const key_t& key) const {
+    return hash(key, seed2_) & (numBuckets_ - 1);
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr bool StaticCuckooMap<key_t, value_t, N>::place(const std::initializer_list<std::pair<key_t, value_t>>& items){
+    std::array<bool, numBuckets_> valid1{};
+    std::array<bool, numBuckets_> valid2{};
+    for (const auto& [key, value] : items){
+        // A placed duplicate is always in one of the key's two spots
+        size_t h1 = getHash1(key);
+        size_t h2 = getHash2(key);
+        if ((valid1[h1] and keyEqual(table1_[h1].key_, key)) or (valid2[h2] and keyEqual(table2_[h2].key_, key))){
+            throw std::invalid_argument("StaticCuckooMap: duplicate key");
+        }
+
+        Item newItem{key, value};
+        bool placed = false;
+        for (size_t loops = 0; loops < numBuckets_ and !placed; ++loops){
+            h1 = getHash1(newItem.key_);
+            if (!valid1[h1]){
+                table1_[h1] = newItem;
+                valid1[h1] = true;
+                placed = true;
+                continue;
+            }
+            std::swap(newItem, table1_[h1]);
+            h2 = getHash2(newItem.key_);
+            if (!valid2[h2]){
+                table2_[h2] = newItem;
+                valid2[h2] = true;
+                placed = true;
+            } else {
+                std::swap(newItem, table2_[h2]);
+            }
+        }
+        if (!placed){
+            return false;
+        }
+    }
+
+    // Fill empty slots with the first item. Any slot holding that key holds
+    // its value, so lookups never need a valid flag.
+    filler_ = Item{items.begin()->first, items.begin()->second};
+    for (size_t i = 0; i < numBuckets_; ++i){
+        if (!valid1[i]){
+            table1_[i] = filler_;
+        }
+        if (!valid2[i]){
+            table2_[i] = filler_;
+        }
+    }
+    return true;
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr bool StaticCuckooMap<key_t, value_t, N>::contains(const key_t& key) const {
+    // Both probes are always made, no early exit
+    return keyEqual(table1_[getHash1(key)].key_, key) | keyEqual(table2_[getHash2(key)].key_, key);
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr const value_t& StaticCuckooMap<key_t, value_t, N>::lookup(const key_t& key) const {
+    // Select without branching: item1, else item2, else the filler
+    const Item &item1 = table1_[getHash1(key)];
+    const Item &item2 = table2_[getHash2(key)];
+    const Item *candidates[4] = {&filler_, &item2, &item1, &item1};
+    return candidates[2 * keyEqual(item1.key_, key) + keyEqual(item2.key_, key)]->value_;
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr const value_t& StaticCuckooMap<key_t, value_t, N>::operator[](const key_t& key) const {
+    return lookup(key);
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr bool StaticCuckooMap<key_t, value_t, N>::empty() const {
+    return false;
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr size_t StaticCuckooMap<key_t, value_t, N>::size() const {
+    return N;
+}
+
+template <typename key_t, typename value_t, size_t N>
+constexpr double StaticCuckooMap<key_t, value_t, N>::loadFactor() const {
+    return double(N) / (2 * numBuckets_);
+}
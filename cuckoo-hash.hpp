@@ -1,23 +1,144 @@
 /**
  * @file cuckoo-hash.hpp
  * @author Ryan Butler (rbutler@g.hmc.edu)
- * @brief Implementation of a Cuckoo Hash Set and Hash Map 
+ * @brief Implementation of a Cuckoo Hash Set, Hash Map, Cuckoo Filter and a
+ * compile time Static Cuckoo Map
  * @note Keys and Values must implement a copy constructor
  * @version 1.0
  * @date 2023-07-04
  * @copyright Copyright (c) 2023
  * 
  */
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <cmath>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <istream>
+#include <ostream>
 #include <vector>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
 #include <tuple>
+#include <array>
+#include <bit>
+#include <initializer_list>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 #ifndef CUCKOO_HASH_HPP_INCLUDED
 #define CUCKOO_HASH_HPP_INCLUDED
 
+// Define CUCKOO_HASH_NUMA and link with -lnuma to place tables on NUMA nodes
+#if defined(CUCKOO_HASH_NUMA) && __has_include(<numa.h>)
+#include <numa.h>
+#define CUCKOO_HASH_HAS_LIBNUMA 1
+#endif
+
+// Define CUCKOO_HASH_PERSISTENT on a POSIX system to use PersistentCuckooHashMap
+#if defined(CUCKOO_HASH_PERSISTENT) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <unistd.h>
+#define CUCKOO_HASH_HAS_POSIX 1
+#endif
+
+/**
+ * @brief Round robin queue of suspended coroutines. Lookups suspend into it
+ * after prefetching, so many lookups' cache misses overlap.
+ */
+class CuckooScheduler
+{
+  private:
+    std::deque<std::coroutine_handle<>> ready_;
+
+  public:
+    struct Yield {
+        CuckooScheduler &scheduler_;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler_.schedule(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    // Suspends the calling coroutine to the back of the queue
+    Yield yield();
+    void schedule(std::coroutine_handle<> handle);
+    // Resumes coroutines until none are left
+    void run();
+    bool empty() const;
+};
+
+/**
+ * @brief Lazily started coroutine returning a T. Either co_await it from
+ * another coroutine, or start() it on a scheduler with an optional callback.
+ */
+template <typename T>
+class CuckooTask
+{
+  public:
+    struct promise_type {
+        T value_{};
+        std::coroutine_handle<> continuation_;
+        std::function<void(T)> onDone_;
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() const noexcept {}
+        };
+
+        CuckooTask get_return_object();
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(T value) { value_ = value; }
+        void unhandled_exception() { throw; }
+    };
+
+    CuckooTask(CuckooTask &&other) noexcept;
+    CuckooTask(const CuckooTask &other) = delete;
+    ~CuckooTask();
+
+    void start(CuckooScheduler &scheduler, std::function<void(T)> onDone = {});
+    bool done() const;
+    T result() const;
+
+    // Awaiting a task starts it and resumes the awaiter when it finishes
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter);
+    T await_resume() const { return result(); }
+
+  private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit CuckooTask(std::coroutine_handle<promise_type> handle);
+};
+
+// Bytes used by a map or set, from memoryUsage()
+struct CuckooMemoryUsage {
+    size_t slotBytes; // Both slot arrays, including empty slots
+    size_t paddingBytes; // Part of slotBytes lost to Item alignment
+    size_t metadataBytes; // The object itself and valid flag vectors
+    size_t heapBytes; // Heap owned by stored keys and values (std::string)
+    size_t peakResizeBytes; // Largest slot arrays plus scratch seen in a rehash
+
+    size_t total() const { return slotBytes + metadataBytes + heapBytes; }
+};
+
+// Binary encoding for snapshots and logs. Supports trivially copyable types and std::string.
+template <typename T>
+void cuckooWrite(std::ostream &os, const T &field);
+template <typename T>
+bool cuckooRead(std::istream &is, T &field);
+
 template <typename key_t, typename value_t>
 class CuckooHashMap
 {
@@ -28,6 +149,7 @@ class CuckooHashMap
         key_t key_;
         value_t value_;
         bool valid_; // Way to check if it is valid after deletions.
+        uint8_t hits_; // Reads in access aware mode, halved by rebalance()
 
         Item(); // For invalid deleted items. 
         Item(key_t &key, value_t &value); // For valid items. 
@@ -36,6 +158,7 @@ class CuckooHashMap
     };
 
     // Data
+    int numaNode_; // -1 allocates tables with new[]
     Item* table1_;
     Item* table2_;
     double epsilon_;
@@ -44,32 +167,56 @@ class CuckooHashMap
     size_t numBuckets_;
     std::hash<key_t> hash1_;
     std::hash<std::string> hash2_;
+    size_t seed1_; // Random per instance so collisions can't be precomputed
+    size_t seed2_;
+    size_t reseeds_; // Failed cycles fixed by reseeding at this numBuckets_
+    bool fixedSeeds_; // Draw seeds from seedState_ instead of std::random_device
+    uint64_t seedState_;
     float downsizeThresh_;
+    bool accessAware_; // Count hits and keep hot items in table 1
+    size_t peakResizeBytes_;
 
     // Helper Functions
+    static size_t randomSeed();
+    size_t nextSeed();
+    void recordHit(Item &item) const;
+    Item* allocateTable(size_t numBuckets) const;
+    void freeTable(Item* table, size_t numBuckets) const;
     size_t getHash1(const key_t& key) const;
     size_t getHash2(size_t hash1) const;
     void rehash(size_t numBuckets);
+    void rehash(size_t numBuckets, bool reseed);
     void insert(const key_t& key, const value_t& value, bool updateValues);
+    void insert(Item newItem, bool updateValues);
 
   public:
     // Constructors
     CuckooHashMap();
     CuckooHashMap(double epsilon, float downsizeThresh);
+    CuckooHashMap(double epsilon, float downsizeThresh, int numaNode);
     ~CuckooHashMap();
-    CuckooHashMap(const CuckooHashMap &other) = delete;
+    CuckooHashMap(const CuckooHashMap &other); // Copies slots, no rehashing
+    CuckooHashMap &operator=(const CuckooHashMap &other);
 
     // Modification and Lookup;
     bool contains(const key_t &key) const;
     void insert(const key_t& key, const value_t& value);
     void erase(const key_t& key); 
     value_t &lookup(const key_t& key) const;
+    CuckooTask<value_t*> lookupAsync(key_t key, CuckooScheduler &scheduler) const;
     void clear();
+    void reseed();
+    void seed(uint64_t seed); // Reproducible seeds, for replaying tests
+
+    void setAccessAware(bool enabled);
+    void rebalance();
 
     // Data Lookup
     bool empty() const;
     size_t size() const;
     double loadFactor() const;
+    CuckooMemoryUsage memoryUsage() const;
+    void compact(double targetLoad);
 
     // Iterator Functions
     const_iterator begin() const;
@@ -78,6 +225,10 @@ class CuckooHashMap
     value_t &operator[](const key_t& key);
     void printToStream(std::ostream &os) const;
 
+    // Saves the slot arrays and seeds so loading skips rehashing
+    void writeSnapshot(std::ostream &os) const;
+    bool readSnapshot(std::istream &is);
+
   private: 
     class const_iterator {
         friend class CuckooHashMap;
@@ -132,13 +283,23 @@ class CuckooHashSet
     size_t numBuckets_;
     std::hash<T> hash1_;
     std::hash<std::string> hash2_;
+    size_t seed1_; // Random per instance so collisions can't be precomputed
+    size_t seed2_;
+    size_t reseeds_; // Failed cycles fixed by reseeding at this numBuckets_
+    bool fixedSeeds_; // Draw seeds from seedState_ instead of std::random_device
+    uint64_t seedState_;
     float downsizeThresh_;
+    size_t peakResizeBytes_;
 
     // Helper Functions
+    static size_t randomSeed();
+    size_t nextSeed();
     size_t getHash1(const T& key) const;
     size_t getHash2(size_t hash1) const;
     void rehash(size_t numBuckets);
+    void rehash(size_t numBuckets, bool reseed);
     void insert(const T& key, bool updateValues);
+    void insertNew(T newKey, bool updateValues); // key must not be present
 
   public:
 
@@ -152,12 +313,16 @@ class CuckooHashSet
     bool empty() const;
     size_t size() const;
     double loadFactor() const;
+    CuckooMemoryUsage memoryUsage() const;
+    void compact(double targetLoad);
 
     // Modification and Lookup
     bool contains(const T &key) const;
     void insert(const T& key);
     void erase(const T& key);
     void clear();
+    void reseed();
+    void seed(uint64_t seed); // Reproducible seeds, for replaying tests
 
     // Iterators
     const_iterator begin() const;
@@ -200,11 +365,309 @@ class CuckooHashSet
     };
 };
 
+template<typename T>
+class CuckooFilter
+{
+  private:
+    using fingerprint_t = uint16_t; // 0 marks an empty slot
+    static constexpr size_t slotsPerBucket_ = 4;
+    static constexpr double maxLoad_ = 0.95; // Used to size the first table
+    static constexpr size_t maxTables_ = 8; // Up to 255x the first table's capacity
+
+    // Fingerprints can't be rehashed into a bigger table, so the filter
+    // grows by appending a table with twice the buckets of the last one.
+    struct Table {
+        std::vector<uint8_t> bits_; // Slots packed fingerprintBits_ apart
+        size_t numBuckets_; // Always a power of 2
+        size_t size_;
+        size_t maxLoop_; // set to 3 log_1+e(n)
+
+        Table(size_t numBuckets, size_t fingerprintBits);
+    };
+
+    // Data
+    std::vector<Table> tables_;
+    double epsilon_;
+    double falsePositiveRate_;
+    size_t fingerprintBits_;
+    size_t size_;
+    size_t kickCounter_; // Rotates which slot gets evicted
+    std::hash<T> hash1_;
+
+    // Helper Functions
+    uint64_t getHash1(const T& key) const;
+    fingerprint_t getFingerprint(uint64_t hash1) const;
+    size_t getAltIndex(size_t index, fingerprint_t fp, size_t numBuckets) const;
+    fingerprint_t getSlot(const Table &table, size_t slot) const;
+    void setSlot(Table &table, size_t slot, fingerprint_t fp) const;
+    bool bucketInsert(Table &table, size_t index, fingerprint_t fp);
+    bool bucketContains(const Table &table, size_t index, fingerprint_t fp) const;
+    bool bucketErase(Table &table, size_t index, fingerprint_t fp);
+    size_t bucketCount(const Table &table, size_t index, fingerprint_t fp) const;
+    bool insert(Table &table, uint64_t hash1, fingerprint_t fp);
+    void addTable(size_t numBuckets);
+
+  public:
+    // Constructors
+    CuckooFilter();
+    CuckooFilter(double falsePositiveRate, size_t capacity);
+    ~CuckooFilter() = default;
+    CuckooFilter(const CuckooFilter &other) = delete;
+
+    // Capacity
+    bool empty() const;
+    size_t size() const;
+    double loadFactor() const;
+    double falsePositiveRate() const;
+
+    // Modification and Lookup
+    bool contains(const T &key) const;
+    void insert(const T& key);
+    bool insertIfAbsent(const T& key);
+    bool erase(const T& key);
+    void clear();
+
+    void printToStream(std::ostream &os) const;
+};
+
+/**
+ * @brief Cuckoo hash map over a fixed set of keys, built at compile time.
+ * @note Keys must be integral or convertible to std::string_view. Construct
+ * with exactly N key-value pairs. Keys and values must be default constructible.
+ * Looking up a missing key returns the first pair's value, so check contains.
+ */
+template <typename key_t, typename value_t, size_t N>
+class StaticCuckooMap
+{
+  private:
+    static_assert(N > 0, "StaticCuckooMap needs at least one key");
+    static_assert(std::is_integral_v<key_t> or std::is_convertible_v<const key_t&, std::string_view>,
+                  "StaticCuckooMap keys must be integral or convertible to std::string_view");
+
+    struct Item {
+        key_t key_;
+        value_t value_;
+    };
+
+    // Keeps the load at or below 1/4 so a placement is found in a few seeds
+    static constexpr size_t numBuckets_ = std::bit_ceil(2 * N);
+    static constexpr size_t maxSeeds_ = 64;
+
+    // Data
+    std::array<Item, numBuckets_> table1_;
+    std::array<Item, numBuckets_> table2_;
+    Item filler_; // The first pair, fills empty slots and answers missing keys
+    uint64_t seed1_;
+    uint64_t seed2_;
+
+    // Helper Functions
+    static constexpr uint64_t hash(const key_t& key, uint64_t seed);
+    static constexpr bool keyEqual(const key_t& a, const key_t& b);
+    constexpr size_t getHash1(const key_t& key) const;
+    constexpr size_t getHash2(const key_t& key) const;
+    constexpr bool place(const std::initializer_list<std::pair<key_t, value_t>>& items);
+
+  public:
+    // Constructors
+    constexpr StaticCuckooMap(std::initializer_list<std::pair<key_t, value_t>> items);
+
+    // Lookup
+    constexpr bool contains(const key_t &key) const;
+    constexpr const value_t &lookup(const key_t& key) const;
+    constexpr const value_t &operator[](const key_t& key) const;
+
+    // Data Lookup
+    constexpr bool empty() const;
+    constexpr size_t size() const;
+    constexpr double loadFactor() const;
+};
+
+/**
+ * @brief Splits keys across independent CuckooHashMap shards by the high bits
+ * of their hash. Each shard resizes on its own, and with CUCKOO_HASH_NUMA the
+ * shards' tables are spread round robin over the NUMA nodes.
+ * @note Without libnuma, tables are placed by first touch, so a shard's memory
+ * lands on the node of the thread that last resized it.
+ */
+template <typename key_t, typename value_t>
+class ShardedCuckooHashMap
+{
+  private:
+    // Data
+    std::vector<std::unique_ptr<CuckooHashMap<key_t, value_t>>> shards_;
+    size_t shardBits_; // numShards = 2^shardBits_
+    uint64_t seed_; // Random per instance, so shard routing can't be predicted
+    std::hash<key_t> hash_;
+
+    // Helper Functions
+    size_t getShard(const key_t& key) const;
+
+  public:
+    // Constructors
+    ShardedCuckooHashMap();
+    ShardedCuckooHashMap(size_t numShards);
+    ShardedCuckooHashMap(size_t numShards, double epsilon, float downsizeThresh);
+    ~ShardedCuckooHashMap() = default;
+    ShardedCuckooHashMap(const ShardedCuckooHashMap &other) = delete;
+
+    // Modification and Lookup
+    bool contains(const key_t &key) const;
+    void insert(const key_t& key, const value_t& value);
+    void erase(const key_t& key);
+    value_t &lookup(const key_t& key) const;
+    void clear();
+
+    // Data Lookup
+    bool empty() const;
+    size_t size() const;
+    double loadFactor() const;
+    size_t numShards() const;
+    const CuckooHashMap<key_t, value_t> &shard(size_t idx) const;
+
+    value_t &operator[](const key_t& key);
+    void printToStream(std::ostream &os) const;
+};
+
+#ifdef CUCKOO_HASH_HAS_POSIX
+/**
+ * @brief CuckooHashMap that survives crashes. Inserts and erases are appended
+ * to a write ahead log that is written and fsynced in groups, and the slot
+ * arrays are checkpointed every checkpointOps operations. Opening the map
+ * loads the checkpoint and replays the log tail.
+ * @note Operations still in the group buffer are lost on a crash; call sync()
+ * to make them durable. Keys and values must be trivially copyable or std::string.
+ */
+template <typename key_t, typename value_t>
+class PersistentCuckooHashMap
+{
+  private:
+    enum class Op : uint8_t { Insert = 1, Erase = 2, Clear = 3 };
+
+    // Data
+    CuckooHashMap<key_t, value_t> map_;
+    std::string logPath_;
+    std::string checkpointPath_;
+    int logFd_;
+    std::string buffer_; // Encoded records not yet written to the log
+    size_t groupBytes_; // Flush the buffer once it is this large
+    size_t checkpointOps_;
+    size_t opsSinceCheckpoint_;
+
+    // Helper Functions
+    void append(Op op, const key_t* key, const value_t* value);
+    void recover();
+    void openLog(bool truncate);
+
+  public:
+    // Constructors
+    PersistentCuckooHashMap(const std::string& path);
+    PersistentCuckooHashMap(const std::string& path, size_t groupBytes, size_t checkpointOps);
+    ~PersistentCuckooHashMap();
+    PersistentCuckooHashMap(const PersistentCuckooHashMap &other) = delete;
+
+    // Modification and Lookup
+    bool contains(const key_t &key) const;
+    void insert(const key_t& key, const value_t& value);
+    void erase(const key_t& key);
+    const value_t &lookup(const key_t& key) const;
+    void clear();
+
+    // Durability
+    void sync();
+    void checkpoint();
+
+    // Data Lookup
+    bool empty() const;
+    size_t size() const;
+    double loadFactor() const;
+    const CuckooHashMap<key_t, value_t> &map() const;
+};
+#endif // CUCKOO_HASH_HAS_POSIX
+
+/**
+ * @brief Many reader, one writer CuckooHashMap using read-copy-update.
+ * Readers see an immutable version of the map without locking. Writers copy
+ * the current version, change the copy and publish it with one atomic store.
+ * Old versions are freed once no reader that could see them is still reading.
+ * @note Each reading thread needs its own Reader. Writers are serialized.
+ */
+template <typename key_t, typename value_t>
+class RcuCuckooHashMap
+{
+  private:
+    using map_t = CuckooHashMap<key_t, value_t>;
+
+    static constexpr size_t maxReaders_ = 128;
+    static constexpr uint64_t freeSlot_ = UINT64_MAX;
+    static constexpr uint64_t idleSlot_ = UINT64_MAX - 1;
+
+    // One cache line per reader so readers don't slow each other down
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch_{freeSlot_};
+    };
+
+    struct Retired {
+        const map_t* map_;
+        uint64_t epoch_; // Readers in this epoch or earlier may still see it
+    };
+
+    // Data
+    std::atomic<const map_t*> current_;
+    std::atomic<uint64_t> epoch_;
+    std::unique_ptr<Slot[]> slots_;
+    std::vector<Retired> retired_;
+    std::mutex writeMutex_;
+
+    // Helper Functions
+    void publish(std::unique_ptr<const map_t> map);
+    void reclaim();
+
+  public:
+    class Reader {
+      private:
+        RcuCuckooHashMap &rcu_;
+        Slot *slot_;
+
+      public:
+        Reader(RcuCuckooHashMap &rcu);
+        ~Reader();
+        Reader(const Reader &other) = delete;
+
+        // Runs f(const CuckooHashMap&) on the current version
+        template <typename F>
+        auto read(F f);
+        bool contains(const key_t &key);
+        value_t lookup(const key_t& key);
+    };
+
+    // Constructors
+    RcuCuckooHashMap();
+    ~RcuCuckooHashMap(); // No Reader may outlive the map
+    RcuCuckooHashMap(const RcuCuckooHashMap &other) = delete;
+
+    // Modification, each call publishes one new version
+    template <typename F>
+    void update(F f);
+    void insert(const key_t& key, const value_t& value);
+    void erase(const key_t& key);
+    void clear();
+
+    // Waits until every retired version has been freed
+    void synchronize();
+    Reader reader();
+};
+
 template<typename key_t,typename value_t>
 std::ostream &operator<<(std::ostream& os, const CuckooHashMap<key_t, value_t> &ch );
 
+template<typename key_t,typename value_t>
+std::ostream &operator<<(std::ostream& os, const ShardedCuckooHashMap<key_t, value_t> &sh );
+
 template<typename T>
 std::ostream &operator<<(std::ostream& os, const CuckooHashSet<T> &ch );
+
+template<typename T>
+std::ostream &operator<<(std::ostream& os, const CuckooFilter<T> &cf );
 #include "cuckoo-hash-private.hpp"
 
 #endif // CUCKOO_HASH_HPP_INCLUDED
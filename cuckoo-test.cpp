@@ -1,10 +1,28 @@
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+#define CUCKOO_HASH_PERSISTENT
 #include "cuckoo-hash.hpp"
 
 
 using namespace std;
 
+// Every key hashes the same, so no seed can separate them
+struct CollidingKey {
+    int id;
+    bool operator==(const CollidingKey &other) const { return id == other.id; }
+};
+
+template <>
+struct std::hash<CollidingKey> {
+    size_t operator()(const CollidingKey&) const { return 42; }
+};
 
 int main()
 {
@@ -34,12 +52,300 @@ int main()
     }
     cout << endl;
 
+    // Reseeding keeps every key
+    ch.reseed();
+    for (size_t i = 20; i < 30; ++i){
+        assert(ch[keys[i]] == values[i]);
+    }
+
+    // Copy assignment owns its own tables
+    CuckooHashMap<string, int> assigned;
+    assigned.insert("x", 1);
+    assigned = ch;
+    assigned.erase(keys[20]);
+    assert(!assigned.contains("x") and !assigned.contains(keys[20]));
+    assert(ch[keys[20]] == values[20] and assigned[keys[21]] == values[21]);
+
+    // Fixed seeds give identical tables
+    CuckooHashSet<string> seeded1, seeded2;
+    seeded1.seed(42);
+    seeded2.seed(42);
+    for (size_t i = 0; i < 30; ++i){
+        seeded1.insert(keys[i]);
+        seeded2.insert(keys[i]);
+    }
+    auto it2 = seeded2.begin();
+    for (const string& s : seeded1){
+        assert(s == *it2);
+        ++it2;
+    }
+
+    // Keys differing only in high bits still spread over the buckets
+    for (int shift : {40, 48}){
+        CuckooHashMap<long, long> wideMap;
+        CuckooHashSet<long> wideSet;
+        for (long i = 0; i < 20000; ++i){
+            wideMap.insert(i << shift, i);
+            wideSet.insert(i << shift);
+        }
+        wideMap.reseed();
+        wideSet.reseed();
+        assert(wideMap.size() == 20000 and wideSet.size() == 20000);
+        assert(wideMap.loadFactor() > 0.15 and wideSet.loadFactor() > 0.15);
+        for (long i = 0; i < 20000; ++i){
+            assert(wideMap.lookup(i << shift) == i and wideSet.contains(i << shift));
+        }
+    }
+
+    // Keys sharing a std::hash value throw instead of doubling without end
+    CuckooHashMap<CollidingKey, int> collideMap;
+    CuckooHashSet<CollidingKey> collideSet;
+    for (int i = 0; i < 2; ++i){
+        collideMap.insert(CollidingKey{i}, i);
+        collideSet.insert(CollidingKey{i});
+    }
+    bool threw = false;
+    try {
+        collideMap.insert(CollidingKey{2}, 2);
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    assert(threw and collideMap.size() == 2 and collideMap.loadFactor() >= 2.0 / 32);
+    assert(collideMap.lookup(CollidingKey{0}) == 0 and collideMap.lookup(CollidingKey{1}) == 1);
+    threw = false;
+    try {
+        collideSet.insert(CollidingKey{2});
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    assert(threw and collideSet.size() == 2 and collideSet.loadFactor() >= 2.0 / 32);
+    assert(collideSet.contains(CollidingKey{0}) and collideSet.contains(CollidingKey{1}));
+
+    // Hot/cold placement keeps every key reachable
+    ch.setAccessAware(true);
+    for (size_t i = 0; i < 100; ++i){
+        assert(ch.lookup(keys[25]) == values[25]);
+    }
+    ch.rebalance();
+    ch.insert("hot", 1);
+    for (size_t i = 20; i < 30; ++i){
+        assert(ch.contains(keys[i]) and ch[keys[i]] == values[i]);
+    }
+
+    // Keys read often move from table 2 to table 1 on rebalance
+    CuckooHashMap<int, int> hotMap;
+    hotMap.seed(7);
+    for (int i = 0; i < 2000; ++i){
+        hotMap.insert(i, i);
+    }
+    auto table2Keys = [&hotMap](){
+        ostringstream dump;
+        dump << hotMap;
+        string table2 = dump.str();
+        table2 = table2.substr(table2.find("Table 2:"));
+        vector<int> found;
+        for (int i = 0; i < 2000; ++i){
+            if (table2.find("(" + to_string(i) + ": ") != string::npos){
+                found.push_back(i);
+            }
+        }
+        return found;
+    };
+    vector<int> cold = table2Keys();
+    cold.resize(std::min(cold.size(), size_t(200)));
+    assert(!cold.empty());
+    hotMap.setAccessAware(true);
+    for (int key : cold){
+        for (size_t i = 0; i < 10; ++i){
+            assert(hotMap.lookup(key) == key);
+        }
+    }
+    hotMap.rebalance();
+    vector<int> stillCold = table2Keys();
+    size_t moved = 0;
+    for (int key : cold){
+        moved += find(stillCold.begin(), stillCold.end(), key) == stillCold.end();
+    }
+    // Only keys whose table 1 spot is free, or can be freed, move
+    assert(moved * 4 > cold.size());
+
+    // Memory accounting and compaction
+    ch.compact(0.4);
+    assert(ch.loadFactor() <= 1 / (2 * 1.3) + 1e-9); // Clamped for epsilon 0.3
+    threw = false;
+    try {
+        ch.compact(0);
+    } catch (const invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    CuckooMemoryUsage usage = ch.memoryUsage();
+    assert(usage.slotBytes > 0 and usage.total() >= usage.slotBytes);
+    for (size_t i = 20; i < 30; ++i){
+        assert(ch[keys[i]] == values[i]);
+    }
+
+    // Interleaved async lookups
+    CuckooScheduler scheduler;
+    vector<CuckooTask<int*>> tasks;
+    size_t found = 0;
+    for (size_t i = 15; i < 30; ++i){
+        tasks.push_back(ch.lookupAsync(keys[i], scheduler));
+        tasks.back().start(scheduler, [&found](int* value){ found += value != nullptr; });
+    }
+    scheduler.run();
+    assert(found == 10); // keys 0-19 were erased
+    assert(*tasks.back().result() == values[29]);
+
+    // Lookups suspended across a rehash still find their keys
+    found = 0;
+    tasks.clear();
+    for (size_t i = 20; i < 30; ++i){
+        tasks.push_back(ch.lookupAsync(keys[i], scheduler));
+        tasks.back().start(scheduler, [&found](int* value){ found += value != nullptr; });
+    }
+    // Queued behind the lookups, so it runs while they are suspended
+    auto grow = [&ch]() -> CuckooTask<int> {
+        ch.reseed();
+        for (size_t i = 0; i < 100; ++i){
+            ch.insert("grow" + to_string(i), int(i));
+        }
+        co_return 0;
+    };
+    CuckooTask<int> growTask = grow();
+    growTask.start(scheduler, nullptr);
+    scheduler.run();
+    assert(found == 10);
+    for (size_t i = 0; i < 100; ++i){
+        ch.erase("grow" + to_string(i));
+    }
+
+    // SHARDED CUCKOO MAP
+    ShardedCuckooHashMap<string, int> sh = ShardedCuckooHashMap<string, int>(4);
+    for (size_t i = 0; i < 30; ++i){
+        sh.insert(keys[i], values[i]);
+    }
+    assert(sh.size() == 30);
+    for (size_t i = 0; i < 20; ++i)
+    {
+        assert(values[i] == sh[keys[i]]);
+        sh.erase(keys[i]);
+    }
+    assert(sh.size() == 10 and !sh.contains(keys[0]));
+
+    // PERSISTENT CUCKOO MAP
+    remove("cuckoo-test-wal.log");
+    remove("cuckoo-test-wal.ckpt");
+    {
+        // Checkpoint every 10 operations so recovery uses both files
+        PersistentCuckooHashMap<string, int> pm("cuckoo-test-wal", 64, 10);
+        for (size_t i = 0; i < 30; ++i){
+            pm.insert(keys[i], values[i]);
+        }
+        for (size_t i = 0; i < 5; ++i){
+            pm.erase(keys[i]);
+        }
+    }
+    {
+        PersistentCuckooHashMap<string, int> pm("cuckoo-test-wal");
+        assert(pm.size() == 25 and !pm.contains(keys[0]));
+        for (size_t i = 5; i < 30; ++i){
+            assert(pm.lookup(keys[i]) == values[i]);
+        }
+    }
+    {
+        // A torn header with a huge length is dropped, not allocated
+        FILE* log = fopen("cuckoo-test-wal.log", "ab");
+        uint32_t torn[2] = {0xFFFFFFF0u, 0};
+        fwrite(torn, sizeof(torn), 1, log);
+        fclose(log);
+        PersistentCuckooHashMap<string, int> pm("cuckoo-test-wal");
+        assert(pm.size() == 25 and pm.lookup(keys[29]) == values[29]);
+    }
+    {
+        // Crash after clear's empty checkpoint, before the log is truncated
+        string preClear;
+        {
+            PersistentCuckooHashMap<string, int> pm("cuckoo-test-wal", 64, 1000);
+            for (int i = 0; i < 10; ++i){
+                pm.insert("wal" + to_string(i), i);
+            }
+            pm.sync();
+            ifstream in("cuckoo-test-wal.log", ios::binary);
+            preClear.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            pm.clear();
+        }
+        // The log as clear() left it before truncating: old records, then a
+        // clear record (op 3, no key)
+        string clearRecord(1, char(3));
+        uint32_t header[2] = {uint32_t(clearRecord.size()), cuckooChecksum(clearRecord)};
+        ofstream out("cuckoo-test-wal.log", ios::binary | ios::trunc);
+        out << preClear;
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out << clearRecord;
+        out.close();
+        PersistentCuckooHashMap<string, int> pm("cuckoo-test-wal");
+        assert(pm.size() == 0 and !pm.contains("wal0"));
+    }
+    remove("cuckoo-test-wal.log");
+    remove("cuckoo-test-wal.ckpt");
+
+    // RCU CUCKOO MAP
+    RcuCuckooHashMap<string, int> rcu;
+    rcu.update([&](CuckooHashMap<string, int> &copy){
+        for (size_t i = 0; i < 30; ++i){
+            copy.insert(keys[i], values[i]);
+        }
+    });
+    auto rcuReader = rcu.reader();
+    rcu.erase(keys[0]);
+    assert(!rcuReader.contains(keys[0]) and rcuReader.lookup(keys[1]) == values[1]);
+    rcu.synchronize();
+    // A throwing update publishes nothing
+    try {
+        rcu.update([&](CuckooHashMap<string, int> &copy){
+            copy.erase(keys[1]);
+            throw runtime_error("abort update");
+        });
+    } catch (const runtime_error&) {}
+    assert(rcu.reader().lookup(keys[1]) == values[1]);
+
+    // Readers on other threads see whole versions while the writer publishes
+    rcu.insert("gen", 0);
+    atomic<bool> writing{true};
+    vector<thread> readers;
+    for (size_t t = 0; t < 4; ++t){
+        readers.emplace_back([&](){
+            auto reader = rcu.reader();
+            int lastGen = 0;
+            while (writing){
+                int gen = reader.lookup("gen");
+                assert(gen >= lastGen and reader.lookup(keys[25]) == values[25]);
+                lastGen = gen;
+            }
+        });
+    }
+    for (int gen = 1; gen <= 500; ++gen){
+        rcu.update([gen](CuckooHashMap<string, int> &copy){
+            copy.erase("gen");
+            copy.insert("gen", gen);
+        });
+    }
+    writing = false;
+    for (thread &reader : readers){
+        reader.join();
+    }
+    rcu.synchronize();
+    assert(rcu.reader().lookup("gen") == 500);
+
     // CUCKOO SET
     CuckooHashSet<string> cs = CuckooHashSet<string>(0.3, 0.2);
     for (size_t i = 0; i < 30; ++i)
     {
         cs.insert(keys[i]);
     }
+    cs.compact(1.0); // Clamped, so the set stays insertable
+    assert(cs.size() == 30 and cs.loadFactor() <= 1 / (2 * 1.3) + 1e-9);
     cout << cs << endl;
     for (size_t i = 0; i < 25; ++i) 
     {
@@ -57,4 +363,81 @@ int main()
         cout << s << " ";
     }
     cout << endl;
-}
\ No newline at end of file
+
+    // CUCKOO FILTER
+    CuckooFilter<string> cf = CuckooFilter<string>(0.01, 16);
+    for (size_t i = 0; i < 30; ++i)
+    {
+        cf.insert(keys[i]);
+    }
+    for (size_t i = 0; i < 30; ++i)
+    {
+        assert(cf.contains(keys[i])); // No false negatives
+    }
+    for (size_t i = 0; i < 25; ++i)
+    {
+        assert(cf.erase(keys[i]));
+    }
+    assert(cf.size() == 5);
+    for (size_t i = 25; i < 30; ++i)
+    {
+        assert(cf.contains(keys[i]));
+    }
+    cout << cf << endl;
+
+    // Keys that differ only in high bits must still fill the first table
+    CuckooFilter<long> wide = CuckooFilter<long>(0.01, 100000);
+    for (long i = 0; i < 90000; ++i)
+    {
+        wide.insert(i << 32);
+    }
+    for (long i = 0; i < 90000; ++i)
+    {
+        assert(wide.contains(i << 32));
+    }
+    assert(wide.loadFactor() > 0.5);
+
+    // Repeated inserts of one key don't append tables
+    CuckooFilter<string> hot = CuckooFilter<string>(0.01, 64);
+    for (size_t i = 0; i < 100; ++i)
+    {
+        hot.insertIfAbsent("hot");
+    }
+    assert(hot.size() == 1);
+    for (size_t i = 0; i < 7; ++i)
+    {
+        hot.insert("hot");
+    }
+    double load = hot.loadFactor();
+    threw = false;
+    try {
+        hot.insert("hot");
+    } catch (const length_error&) {
+        threw = true;
+    }
+    assert(threw and hot.size() == 8 and hot.loadFactor() == load);
+
+    // STATIC CUCKOO MAP
+    constexpr StaticCuckooMap<string_view, int, 30> sm = {
+        {"a", 1}, {"z", 4}, {"c", 6}, {"d", 5}, {"e", 9}, {"g", 12}, {"s", 22}, {"f", 43},
+        {"h", 47}, {"k", 41}, {"j", 50}, {"i", 40}, {"b", 20}, {"l", 8}, {"t", 7}, {"p", 15},
+        {"n", 13}, {"o", 19}, {"r", 21}, {"q", 90}, {"ab", 104}, {"ac", 102}, {"ad", 103},
+        {"ae", 201}, {"aq", 105}, {"aa", 203}, {"ag", 254}, {"ah", 291}, {"ai", 221}, {"aj", 210}};
+    static_assert(sm.contains("ag") and sm.lookup("ag") == 254);
+    static_assert(!sm.contains("zz"));
+    static_assert(sm.lookup("zz") == 1); // Missing keys return the filler's value
+    for (size_t i = 0; i < 30; ++i)
+    {
+        assert(sm.contains(keys[i]));
+        assert(sm[keys[i]] == values[i]);
+    }
+    for (size_t i = 0; i < 200; ++i)
+    {
+        string miss = "miss" + to_string(i);
+        assert(!sm.contains(miss) and sm.lookup(miss) == 1);
+    }
+    // const char* keys compare by characters, not by address
+    StaticCuckooMap<const char*, int, 2> cm = {{"x", 1}, {"y", 2}};
+    string y = "y";
+    assert(cm.contains(y.c_str()) and cm.lookup(y.c_str()) == 2);
+}